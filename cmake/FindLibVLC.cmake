@@ -0,0 +1,25 @@
+#Find libvlc library
+#Defines
+#   LIBVLC_FOUND
+#   LIBVLC_INCLUDE_DIRS
+#   LIBVLC_LIBRARIES
+#Hint: set LIBVLC_ROOT (or the environment variable of the same name) to the VLC sdk folder
+
+include(FindPackageHandleStandardArgs)
+
+find_package(PkgConfig QUIET)
+if (PKG_CONFIG_FOUND)
+    pkg_check_modules(_LIBVLC QUIET libvlc)
+endif()
+
+find_path(LIBVLC_INCLUDE_DIRS
+    NAMES vlc/vlc.h
+    HINTS ${LIBVLC_ROOT}/include $ENV{LIBVLC_ROOT}/include ${_LIBVLC_INCLUDE_DIRS}
+)
+
+find_library(LIBVLC_LIBRARIES
+    NAMES vlc libvlc
+    HINTS ${LIBVLC_ROOT}/lib $ENV{LIBVLC_ROOT}/lib ${_LIBVLC_LIBRARY_DIRS}
+)
+
+find_package_handle_standard_args(LIBVLC DEFAULT_MSG LIBVLC_LIBRARIES LIBVLC_INCLUDE_DIRS)
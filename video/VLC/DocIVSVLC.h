@@ -10,6 +10,28 @@
  *
  * This plugin is not provided in our installation.  However the source code can be downloaded from our git-hub page.
  *
+ * \section plugin_inputVideoStreamVLC_build Building the Plugin
+ * The plugin is built by CMake when libvlc is found (set LIBVLC_ROOT to the /sdk folder of VLC if needed), together with
+ * tools (option PAPILLON_VLC_BUILD_TOOLS):
+ * - <b>benchmarkVLC</b>: cost of the frame path of the plugin alone ("--mode stub", driven by a stub producer at a given resolution,
+ *   frame rate and number of streams) or end-to-end on a generated local clip ("--mode e2e"); reports ns, allocations, frame arena
+ *   mappings and copies per produced frame, frames produced, delivered and dropped, open time and time-to-first-frame (with
+ *   glibc, allocations are all the malloc-family calls of the process, libvlc included; elsewhere only operator new)
+ * - <b>soakVLC</b>: opens and closes thousands of streams from several threads and fails if memory, file descriptors or threads
+ *   keep growing (compared with no stream open: the workers are paused after the warm-up to take the baseline), if no stream
+ *   opens or if more than "--max-failure-rate" of the opens or frames fail; on Linux, "--server rtsp|http" adds a stand-in
+ *   camera served by a local VLC process (tools/StandInServer.h, shared with loadTestVLC)
+ * - <b>loadTestVLC</b> (Linux): sizes the hardware; serves a generated clip over RTSP or HTTP from a local VLC process, opens
+ *   an increasing number of streams polled without blocking by a pool of consumer threads, reports delivered fps, drop rate,
+ *   latency percentiles, CPU per stream and RSS at each step, and stops at the saturation point (drop rate above "--max-drop",
+ *   all cores busy or a stream failing to open), printing its reason; it fails if no stream at all can be opened; with
+ *   "--jitter-ms J" the stream goes through a relay delaying each frame by 0..J ms
+ *   (tools/JitterRelay.h); the injected jitter is reported next to the "latency" property and, with "--latency adaptive",
+ *   the tool fails if more than "--max-late-fraction" of the frames are still late once the network caching is re-tuned
+ * - <b>shmRingVLC</b> (Linux): forks a writer publishing into a shared-memory ring (SharedFrameRing.h) while the parent reads
+ *   it; "--mode check" fails if a torn frame passes the seqlock check or if re-creating the ring does not bump the generation
+ *   of the old one, "--mode throughput" reports frames/s, GB/s and drop rate for a given geometry and number of slots
+ *
  * \section plugin_inputVideoStreamVLC_create How to read a stream using the VLC plugin?
  * To create a PInputVideoStream to retrieve images from a VLC input stream:
  * \code{.cpp}
@@ -28,13 +50,74 @@
  * - file:...
  *
  * \section plugin_inputVideoStreamVLC_query Options on query string
- * - <b>width=W</b>: width of the stream to retrieve
+ * - <b>width=W</b>: width of the stream to retrieve (libvlc scales the images to width x height)
  * - <b>height=H</b>: height of the stream to retrieve
  * - <b>protocol=P</b>: protocol to be used; for example, P can be "rtsp-tcp", "rtsp-http" or "rtsp-http-port=80"
  * - <b>rgbSwapped</b>: swap red and blue channels of the video stream
+ * - <b>network-caching=N</b>: network caching in ms (default is 1000 ms, or 100 ms with a low/adaptive latency profile)
+ * - <b>latency=L</b>: latency profile, "low" or "adaptive";
+ *   "low" sets a minimal network caching, drops late frames and disables clock jitter compensation;
+ *   "adaptive" does the same but doubles the network caching (up to 3000 ms, never lowered) when more than 1% of the frames
+ *   are dropped by libvlc for being late (input statistics of the media, read every second over windows of at least 100
+ *   frames); the player is restarted, at most every 30 seconds; local files and an explicit network-caching are never re-tuned
+ * - <b>pyramid=N</b>: also deliver N (up to 4) lower resolution levels of each frame, each one half the size of the previous one
+ *   (e.g. pyramid=2 gives 1/2 and 1/4); levels are computed from the same decode with a 2x2 box filter
+ *   (exact rounded mean of each 2x2 block, SSE2 when available)
+ * - <b>shm=NAME</b>: (Linux only) also publish each decoded frame into the POSIX shared-memory ring NAME so that other processes
+ *   can read it without copy; the layout and the seqlock protocol are described in SharedFrameRing.h
+ * - <b>shmSlots=S</b>: number of slots of the shared-memory ring (default is 4)
+ * - <b>priority=P</b>: scheduling priority of the stream, "low", "normal" (default) or "high"
+ *
+ * \section plugin_inputVideoStreamVLC_scheduler Stream scheduler
+ * All the streams opened by the plugin share a process-wide scheduler which measures the CPU load of the process and, on
+ * Linux, of the whole host (so that analytics running in other processes are accounted for); the highest of both is used.
+ * When the load goes above 85%, the delivered frame rate of the most expensive low/normal-priority streams is divided by 2
+ * (down to 1/8), streams whose consumer cannot keep up being throttled first; when the load drops below 60%, the frame rate
+ * is progressively restored. The number of streams adjusted every second grows with the distance to the threshold (up to a
+ * quarter of the candidates). High-priority streams are never throttled. Every adjustment is logged and reported by the
+ * properties below.
+ * The cost of a stream is estimated from the number of pixels it decodes per second, which ignores the codec and the bitrate.
+ * Lowering the delivered frame rate happens after decoding and only relieves the consumers; when decoding is the bottleneck,
+ * network streams throttled to 1/4 or less are also restarted with "avcodec-skip-frame=1" (the decoder skips non-reference
+ * frames, which only helps streams that have some, e.g. B-frames), and restarted without it once fully restored; a stream is
+ * restarted at most every 30 seconds.
+ *
+ * \section plugin_inputVideoStreamVLC_arena Frame arena
+ * The frame buffers of all the streams come from a process-wide arena: slabs are 64-byte aligned and grouped into size classes
+ * (the footprint of a frame geometry rounded up to the page size), so that a slab released by a stream is reused by the next
+ * stream with the same geometry instead of going back to the heap; at most 4 released slabs are kept per class, the others
+ * are unmapped. Each stream holds three slabs of a frame and its pyramid levels, which rotate instead of being copied: the one
+ * libvlc writes into, the last frame not delivered yet (a newer frame replaces it) and the one being copied into the delivered
+ * PImages, so a frame is copied once, by the consumer. The arena is configured by environment variables:
+ * - <b>PAPILLON_VLC_FRAME_ARENA_CAP_MB</b>: maximum memory reserved by the arena (default is no cap); when it is reached,
+ *   cached slabs are released and, if that is not enough, the stream which needs a new buffer fails to start its video output
+ * - <b>PAPILLON_VLC_HUGE_PAGES</b>: (Linux only) "transparent" (default: slabs of 2 MB or more are aligned on 2 MB and advised
+ *   with MADV_HUGEPAGE, without rounding their size), "explicit" (MAP_HUGETLB from the pool reserved with vm.nr_hugepages,
+ *   transparent if the pool is empty; the size class of slabs of 2 MB or more is rounded up to 2 MB) or "off"; slabs smaller
+ *   than 2 MB always use normal pages
  *
  * \section plugin_inputVideoStreamVLC_input_properties Get properties
- * None
+ * - <b>pyramidLevelK</b> (K = 1..N): PImage holding level K of the last frame returned by GetFrame(); the image is reused by the
+ *   plugin and is only valid until the next call to GetFrame()
+ *
+ * The following properties are returned in a PProperties object:
+ * - <b>frameArena</b>: state of the frame arena: "capBytes" (0 if none), "reservedBytes" (used plus cached), "usedBytes",
+ *   "cachedBytes", "peakBytes", "numSlabs", "numCachedSlabs", "numClasses", "numFailures" (allocations refused because of the
+ *   cap or failed), "numHugeTlbFallbacks", "hugePages", "alignment"
+ * - <b>process</b>: resources of the whole process (Linux only, -1 elsewhere): "residentSetSizeInBytes", "numFileDescriptors",
+ *   "numThreads" and "numInstances" (number of plugin instances alive); tools/soakVLC.cpp uses the same counters to check that
+ *   opening and closing streams constantly does not make them grow
+ * - <b>sharedMemory</b>: state of the shared-memory export: "name", "isOpened", "numSlots", "dataCapacity", "numPublished"
+ * - <b>latency</b>: latency of the stream: "profile", "networkCachingMs", "outputJitterMs" and "meanOutputIntervalMs" (measured
+ *   when libvlc renders the frames, i.e. after the network cache: the jitter left, not the one of the network),
+ *   "numLostPictures" and "lateFraction" (late frames dropped by libvlc, adaptive profile only), "decodeToDeliveryMs",
+ *   "lastDecodeToDeliveryMs", "numRetunes" and "glassToFrameEstimateMs" (network caching plus decode-to-delivery time: the
+ *   capture time is not known, so this is an estimate, not a measurement)
+ * - <b>scheduler</b>: global state of the scheduler: "load", "processLoad", "hostLoad" (-1 if unknown), "numCores", "numStreams",
+ *   "numThrottled", "numDecodeReduced", "numAdjustments", "lastAdjustment"
+ * - <b>scheduling</b>: state of the stream: "priority", "decimation", "framesDecoded", "framesDelivered", "framesSkipped",
+ *   "framesConsumed", "decodedFps", "deliveredFps", "consumedFps", "isLagging", "numAdjustments", "lastAdjustment",
+ *   "isDecodeReduced"
  *
  * \section plugin_inputVideoStreamVLC_output_properties Set properties
  * None
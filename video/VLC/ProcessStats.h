@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2014 Digital Barriers plc. All rights reserved.
+ * Contact: http://www.digitalbarriers.com/
+ *
+ * This file is part of the Papillon SDK.
+ *
+ * You can't use, modify or distribute any part of this file without
+ * the explicit written agreements of Digital Barriers plc.
+ */
+
+// ****************************************************************************
+// Description:  resource usage of the current process (resident memory, open
+//               file descriptors, threads), used to track leaks and unbounded
+//               growth of long-running processes.
+//               Only implemented on Linux (read from /proc); other platforms
+//               return -1.
+// ****************************************************************************
+
+#ifndef PAPILLON_PLUGIN_VLC_PROCESS_STATS_H
+#define PAPILLON_PLUGIN_VLC_PROCESS_STATS_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#ifdef __linux__
+#   include <dirent.h>
+#   include <unistd.h>
+#endif
+
+
+struct SProcessStats
+{
+    SProcessStats()
+        : m_residentSetSizeInBytes(-1)
+        , m_numFileDescriptors    (-1)
+        , m_numThreads            (-1)
+    {
+    }
+
+    static SProcessStats Get()
+    {
+        SProcessStats stats;
+#ifdef __linux__
+        FILE* file = fopen("/proc/self/statm", "r");
+        if (file != NULL)
+        {
+            long size = 0, resident = 0;
+            if (fscanf(file, "%ld %ld", &size, &resident) == 2)
+                stats.m_residentSetSizeInBytes = int64_t(resident) * sysconf(_SC_PAGESIZE);
+            fclose(file);
+        }
+
+        file = fopen("/proc/self/status", "r");
+        if (file != NULL)
+        {
+            char line[256];
+            while (fgets(line, sizeof(line), file) != NULL)
+            {
+                if (strncmp(line, "Threads:", 8) == 0)
+                {
+                    stats.m_numThreads = int32_t(atoi(line + 8));
+                    break;
+                }
+            }
+            fclose(file);
+        }
+
+        DIR* dir = opendir("/proc/self/fd");
+        if (dir != NULL)
+        {
+            int32_t count = 0;
+            while (struct dirent* entry = readdir(dir))
+                if (entry->d_name[0] != '.')
+                    ++count;
+            closedir(dir);
+            stats.m_numFileDescriptors = count - 1; // do not count the descriptor of opendir() itself
+        }
+#endif
+        return stats;
+    }
+
+    int64_t m_residentSetSizeInBytes;
+    int32_t m_numFileDescriptors;
+    int32_t m_numThreads;
+};
+
+
+// Cumulated CPU time of the whole host (all processes), in clock ticks: busy / total over an interval is the host load.
+// Only implemented on Linux (read from /proc/stat); Get() returns false elsewhere.
+struct SHostCpuTimes
+{
+    SHostCpuTimes()
+        : m_busy (0)
+        , m_total(0)
+    {
+    }
+
+    static bool Get(SHostCpuTimes& times)
+    {
+#ifdef __linux__
+        FILE* file = fopen("/proc/stat", "r");
+        if (file == NULL)
+            return false;
+        unsigned long long user = 0, nice = 0, system = 0, idle = 0, iowait = 0, irq = 0, softirq = 0, steal = 0;
+        const int n = fscanf(file, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
+        fclose(file);
+        if (n < 4)
+            return false;
+        times.m_busy  = int64_t(user + nice + system + irq + softirq + steal);
+        times.m_total = times.m_busy + int64_t(idle + iowait);
+        return true;
+#else
+        (void)times;
+        return false;
+#endif
+    }
+
+    int64_t m_busy;
+    int64_t m_total;
+};
+
+#endif // PAPILLON_PLUGIN_VLC_PROCESS_STATS_H
@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2014 Digital Barriers plc. All rights reserved.
+ * Contact: http://www.digitalbarriers.com/
+ *
+ * This file is part of the Papillon SDK.
+ *
+ * You can't use, modify or distribute any part of this file without
+ * the explicit written agreements of Digital Barriers plc.
+ */
+
+// ****************************************************************************
+// Description:  ring of decoded frames in POSIX shared memory, written by the
+//               VLC input video stream plugin (option "shm=NAME") and read by
+//               consumers running in other processes.
+//
+// Layout:       [SSharedFrameRingHeader][slot 0]...[slot numSlots-1]
+//               each slot is [SSharedFrameSlotHeader][pixels], aligned on
+//               SHARED_FRAME_RING_ALIGNMENT bytes.
+//
+// Consistency:  each slot is protected by a seqlock: the writer makes the
+//               sequence odd while it writes the slot, then even again.
+//               A reader copies (or processes in place) the slot, then checks
+//               that the sequence did not change; if it did, the frame was
+//               overwritten and must be dropped.
+//               When the frame geometry grows beyond the slot capacity, the
+//               writer re-creates the ring and increments "generation" of the
+//               old one: readers must then re-open the ring.
+// ****************************************************************************
+
+#ifndef PAPILLON_PLUGIN_VLC_SHARED_FRAME_RING_H
+#define PAPILLON_PLUGIN_VLC_SHARED_FRAME_RING_H
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const uint32_t SHARED_FRAME_RING_MAGIC     = 0x434c5650; // "PVLC"
+const uint32_t SHARED_FRAME_RING_VERSION   = 1;
+const uint32_t SHARED_FRAME_RING_ALIGNMENT = 64;
+
+
+struct SSharedFrameRingHeader
+{
+    uint32_t              m_magic;
+    uint32_t              m_version;
+    uint32_t              m_numSlots;
+    uint32_t              m_slotSize;      //!< bytes between two slots (slot header included)
+    uint32_t              m_dataCapacity;  //!< maximum number of pixel bytes in a slot
+    std::atomic<uint32_t> m_generation;    //!< incremented when this ring is abandoned by the writer
+    std::atomic<uint64_t> m_numPublished;  //!< frame i is in slot (i % m_numSlots)
+};
+
+
+struct SSharedFrameSlotHeader
+{
+    std::atomic<uint64_t> m_sequence;      //!< odd while the slot is being written
+    uint64_t              m_index;         //!< index of the frame in the ring (see m_numPublished)
+    uint64_t              m_frameNumber;   //!< frame number in the stream
+    int64_t               m_ptsUs;         //!< UTC time at which the frame was decoded, in microseconds
+    uint32_t              m_width;
+    uint32_t              m_height;
+    uint32_t              m_pitch;         //!< bytes per line
+    char                  m_chroma[4];     //!< libvlc chroma, e.g. "RV24"
+    uint32_t              m_dataSize;
+};
+
+
+inline uint32_t AlignSharedFrameRingSize(uint32_t size)
+{
+    return (size + SHARED_FRAME_RING_ALIGNMENT - 1) / SHARED_FRAME_RING_ALIGNMENT * SHARED_FRAME_RING_ALIGNMENT;
+}
+
+
+// Mapping of a ring, common to the writer and the readers
+class SSharedFrameRing
+{
+public:
+    SSharedFrameRing()
+        : m_name    ()
+        , m_memory  (NULL)
+        , m_size    (0)
+        , m_isOwner (false)
+    {
+    }
+
+    ~SSharedFrameRing()
+    {
+        Close();
+    }
+
+    bool IsOpened() const { return m_memory != NULL; }
+
+    const std::string& GetName() const { return m_name; }
+
+    SSharedFrameRingHeader* GetHeader() const { return static_cast<SSharedFrameRingHeader*>(m_memory); }
+
+    SSharedFrameSlotHeader* GetSlot(uint64_t index) const
+    {
+        const SSharedFrameRingHeader* header = GetHeader();
+        unsigned char* slots = static_cast<unsigned char*>(m_memory) + AlignSharedFrameRingSize(sizeof(SSharedFrameRingHeader));
+        return reinterpret_cast<SSharedFrameSlotHeader*>(slots + (index % header->m_numSlots) * header->m_slotSize);
+    }
+
+    static unsigned char* GetSlotData(SSharedFrameSlotHeader* slot)
+    {
+        return reinterpret_cast<unsigned char*>(slot) + AlignSharedFrameRingSize(sizeof(SSharedFrameSlotHeader));
+    }
+
+    // Writer side: creates (or re-creates) the ring; name must start with '/'
+    bool Create(const std::string& name, uint32_t numSlots, uint32_t dataCapacity)
+    {
+        Close();
+
+        const uint32_t slotSize = AlignSharedFrameRingSize(sizeof(SSharedFrameSlotHeader)) + AlignSharedFrameRingSize(dataCapacity);
+        const size_t   size     = AlignSharedFrameRingSize(sizeof(SSharedFrameRingHeader)) + size_t(slotSize) * numSlots;
+
+        // readers still mapping a previous ring keep their mapping until they re-open
+        shm_unlink(name.c_str());
+        const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0)
+            return false;
+        if (ftruncate(fd, off_t(size)) != 0)
+        {
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+        void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+        {
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        // ftruncate() zero-fills the segment: all sequences start at 0 (even, empty)
+        m_name    = name;
+        m_memory  = memory;
+        m_size    = size;
+        m_isOwner = true;
+
+        SSharedFrameRingHeader* header = GetHeader();
+        header->m_numSlots     = numSlots;
+        header->m_slotSize     = slotSize;
+        header->m_dataCapacity = AlignSharedFrameRingSize(dataCapacity);
+        header->m_version      = SHARED_FRAME_RING_VERSION;
+        header->m_generation.store(0, std::memory_order_relaxed);
+        header->m_numPublished.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->m_magic        = SHARED_FRAME_RING_MAGIC;
+        return true;
+    }
+
+    // Reader side: maps an existing ring read-only
+    bool Open(const std::string& name)
+    {
+        Close();
+
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SSharedFrameRingHeader))
+        {
+            close(fd);
+            return false;
+        }
+        void* memory = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+            return false;
+
+        m_name    = name;
+        m_memory  = memory;
+        m_size    = size_t(st.st_size);
+        m_isOwner = false;
+
+        const SSharedFrameRingHeader* header = GetHeader();
+        if (header->m_magic != SHARED_FRAME_RING_MAGIC || header->m_version != SHARED_FRAME_RING_VERSION)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_memory == NULL)
+            return;
+        if (m_isOwner)
+        {
+            // tell the readers to re-open
+            GetHeader()->m_generation.fetch_add(1, std::memory_order_release);
+            shm_unlink(m_name.c_str());
+        }
+        munmap(m_memory, m_size);
+        m_memory  = NULL;
+        m_size    = 0;
+        m_isOwner = false;
+    }
+
+    // Writer side: copies one frame into the next slot; returns false if it does not fit
+    bool Publish(uint64_t frameNumber, int64_t ptsUs, uint32_t width, uint32_t height, uint32_t pitch, const char* chroma, const void* data, uint32_t dataSize)
+    {
+        SSharedFrameRingHeader* header = GetHeader();
+        if (dataSize > header->m_dataCapacity)
+            return false;
+
+        const uint64_t          index    = header->m_numPublished.load(std::memory_order_relaxed);
+        SSharedFrameSlotHeader* slot     = GetSlot(index);
+        const uint64_t          sequence = slot->m_sequence.load(std::memory_order_relaxed);
+
+        slot->m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->m_index       = index;
+        slot->m_frameNumber = frameNumber;
+        slot->m_ptsUs       = ptsUs;
+        slot->m_width       = width;
+        slot->m_height      = height;
+        slot->m_pitch       = pitch;
+        memcpy(slot->m_chroma, chroma, sizeof(slot->m_chroma));
+        slot->m_dataSize    = dataSize;
+        memcpy(GetSlotData(slot), data, dataSize);
+
+        slot->m_sequence.store(sequence + 2, std::memory_order_release);
+        header->m_numPublished.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Reader side: starts reading frame index in place; returns the sequence to pass to EndRead(), or 0 if the slot is being written
+    // or does not hold this frame anymore
+    uint64_t BeginRead(uint64_t index, SSharedFrameSlotHeader*& slot) const
+    {
+        slot = GetSlot(index);
+        const uint64_t sequence = slot->m_sequence.load(std::memory_order_acquire);
+        if (sequence == 0 || (sequence & 1) != 0 || slot->m_index != index)
+            return 0;
+        return sequence;
+    }
+
+    // Reader side: true if the slot was not overwritten since BeginRead(), i.e. what was read is consistent
+    bool EndRead(const SSharedFrameSlotHeader* slot, uint64_t sequence) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot->m_sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+private:
+    std::string m_name;
+    void*       m_memory;
+    size_t      m_size;
+    bool        m_isOwner;
+};
+
+#endif // PAPILLON_PLUGIN_VLC_SHARED_FRAME_RING_H
@@ -26,11 +26,39 @@
 #include <PPluginInterface.h>
 // libvlc
 #include <vlc/vlc.h>
+// plugin
+#include "ProcessStats.h"
 // STL
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <ctime>
 #include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 #ifdef PAPILLON_LINUX
 #   include <string.h> // for memcpy
+#   include <sys/mman.h> // for the frame arena
+#   include "SharedFrameRing.h"
+#   define USE_SHARED_MEMORY 1
+#else
+#   ifdef _WIN32
+#       include <malloc.h> // for _aligned_malloc
+#   endif
+#   define USE_SHARED_MEMORY 0
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define USE_SSE2 1
+#else
+#   define USE_SSE2 0
 #endif
 
 #define DODEBUG 0
@@ -40,6 +68,11 @@
 #define ONDEBUG(x)
 #endif
 
+// defined by tools/benchmarkVLC.cpp to count the copies made on the frame path
+#ifndef ONBENCH
+#define ONBENCH(x)
+#endif
+
 using namespace papillon;
 
 const PString PRODUCT_NAME        = "VLCInputVideoStream";
@@ -51,12 +84,51 @@ const PString PRODUCT_LOG         = PString("%1 (%2) plugin: ").Arg(PRODUCT_NAME
 
 const int32   DEFAULT_WIDTH                 = 720;
 const int32   DEFAULT_HEIGHT                = 576;
-const int32   MAX_PENDING_IMAGES            = 1;
 const int32   DEFAULT_NETWORK_CACHING_IN_MS = 1000;
+const int32   OPEN_TIMEOUT_IN_SEC           = 10;
 PString       DEFAULT_PROTOCOL              = "no-rtsp-tcp"; // other options are "rtsp-tcp" "rtsp-http" or "rtsp-http-port=80"
 
+// stream scheduler (see SStreamScheduler)
+const double  SCHEDULER_PERIOD_IN_SEC              = 1.0;  // how often the scheduler re-evaluates the load
+const double  SCHEDULER_HIGH_WATERMARK             = 0.85; // CPU load (0..1) above which low-priority streams are throttled
+const double  SCHEDULER_LOW_WATERMARK              = 0.60; // CPU load (0..1) below which throttled streams are restored
+const int32   SCHEDULER_MAX_DECIMATION             = 8;    // deliver at least 1 frame out of 8
+const double  SCHEDULER_MAX_ADJUSTED_FRACTION      = 0.25; // at most 1/4 of the candidate streams adjusted per period
+const int32   SCHEDULER_DECODE_SKIP_DECIMATION     = 4;    // from 1/4, the decoder also skips non-reference frames
+const double  SCHEDULER_MIN_RESTART_PERIOD_IN_SEC  = 30.0; // changing the decoder options restarts the player
+
+// latency profiles (see SLatencyState)
+const int32   LOW_LATENCY_NETWORK_CACHING_IN_MS = 100;
+const int32   MAX_NETWORK_CACHING_IN_MS         = 3000;
+const double  ADAPTIVE_STATS_PERIOD_IN_SEC      = 1.0;  // how often the input statistics of libvlc are read
+const int32   ADAPTIVE_MIN_FRAMES               = 100;  // frames a late-frame window must hold before it is trusted
+const double  ADAPTIVE_MAX_LATE_FRACTION        = 0.01; // more late frames than this in a window double the network caching
+const double  ADAPTIVE_MIN_RETUNE_PERIOD_IN_SEC = 30.0; // a re-tune restarts the player, so do not do it too often
+
+const int32   MAX_PYRAMID_LEVELS            = 4;    // full resolution plus down to 1/16
+
+const int32   DEFAULT_SHARED_MEMORY_SLOTS   = 4;
+
+// frame arena (see SFrameArena)
+const int64   DEFAULT_FRAME_ARENA_CAP_IN_MB          = 0;    // no cap unless PAPILLON_VLC_FRAME_ARENA_CAP_MB is set
+const size_t  FRAME_ARENA_ALIGNMENT                  = 64;
+const size_t  FRAME_ARENA_PAGE_SIZE                  = 4096;
+const size_t  FRAME_ARENA_HUGE_PAGE_SIZE             = 2 * 1024 * 1024;
+const size_t  FRAME_ARENA_MAX_CACHED_SLABS_PER_CLASS = 4;    // slabs released beyond this are unmapped
+
 
 libvlc_instance_t* g_libvlc_instance;
+std::atomic<int32> g_numInstances(0);
+
+
+static void CallbackLoggingVLC(void* /*data*/, int level, const libvlc_log_t *ctx, const char *fmt, va_list args)
+{
+    // note: this function is thread-safe because the Papillon logging system is thread-safe
+    const int MAX_BUFFER_SIZE = 8192;
+    char buffer[MAX_BUFFER_SIZE];
+    vsnprintf(buffer, MAX_BUFFER_SIZE, fmt, args); // clamp buffer larger than MAX_BUFFER_SIZE
+    P_LOG_TRACE << PRODUCT_NAME << ": libVLC log: " << PString(buffer);
+}
 
 
 void PPlugin_OnLoad(PResult& ret)
@@ -66,9 +138,15 @@ void PPlugin_OnLoad(PResult& ret)
         g_libvlc_instance = libvlc_new(0, NULL);
 
         if (g_libvlc_instance == NULL)
+        {
             ret = PResult::Error("unable to create libvlc");
+        }
         else
+        {
+            // libvlc_log_set() must not be called while the instance is in use, so it is done once for all the streams
+            libvlc_log_set(g_libvlc_instance, CallbackLoggingVLC, NULL);
             ret = PResult::C_OK;
+        }
     }
     catch (...)
     {
@@ -79,6 +157,7 @@ void PPlugin_OnLoad(PResult& ret)
 
 void PPlugin_OnUnload(PResult& ret)
 {
+    libvlc_log_unset(g_libvlc_instance);
     libvlc_release(g_libvlc_instance);
     ret = PResult::C_OK;
 }
@@ -94,6 +173,864 @@ void PPlugin_About(PResult& result, PString& productName, PVersion& productVersi
 }
 
 
+// Downscales a packed 24-bit image by 2 in both directions with a 2x2 box filter: each output byte is the exact rounded
+// mean (a + b + c + d + 2) / 4 of its 4 source bytes. dst receives (width/2)x(height/2) pixels.
+static void DownscaleBox2x2(const unsigned char* src, int32 width, int32 height, unsigned char* dst)
+{
+    const int32 srcPitch  = width * 3;
+    const int32 dstWidth  = width / 2;
+    const int32 dstHeight = height / 2;
+
+    for (int32 y = 0; y < dstHeight; ++y)
+    {
+        const unsigned char* row0 = src + 2 * y * srcPitch;
+        const unsigned char* row1 = row0 + srcPitch;
+        unsigned char*       out  = dst + y * dstWidth * 3;
+
+        int32 x = 0;
+#if USE_SSE2
+        // 4 output pixels per iteration: 8 source pixels (24 bytes) of each row, summed in 16 bits
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two  = _mm_set1_epi16(2);
+        const __m128i keep012 = _mm_setr_epi16(-1, -1, -1,  0,  0,  0,  0,  0);
+        const __m128i keep34  = _mm_setr_epi16( 0,  0,  0, -1, -1,  0,  0,  0);
+        const __m128i keep5   = _mm_setr_epi16( 0,  0,  0,  0,  0, -1,  0,  0);
+        const __m128i keep67  = _mm_setr_epi16( 0,  0,  0,  0,  0,  0, -1, -1);
+        const __m128i keep0   = _mm_setr_epi16(-1,  0,  0,  0,  0,  0,  0,  0);
+        const __m128i keep123 = _mm_setr_epi16( 0, -1, -1, -1,  0,  0,  0,  0);
+        for (; x + 4 <= dstWidth; x += 4)
+        {
+            const unsigned char* p0 = row0 + 6 * x;
+            const unsigned char* p1 = row1 + 6 * x;
+            const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+            const __m128i a1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p0 + 16));
+            const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+            const __m128i b1 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p1 + 16));
+
+            // vertical sums v[0..23] of the 24 bytes
+            const __m128i v0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+            const __m128i v1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+            const __m128i v2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+
+            // w[i] = v[i] + v[i + 3]: the sum of a byte and of the same channel in the next pixel
+            const __m128i w0 = _mm_add_epi16(v0, _mm_or_si128(_mm_srli_si128(v0, 6), _mm_slli_si128(v1, 10)));
+            const __m128i w1 = _mm_add_epi16(v1, _mm_or_si128(_mm_srli_si128(v1, 6), _mm_slli_si128(v2, 10)));
+            const __m128i w2 = _mm_add_epi16(v2, _mm_srli_si128(v2, 6));
+
+            // keep w[0..2], w[6..8], w[12..14], w[18..20]: the 12 output bytes
+            const __m128i s0 = _mm_or_si128(_mm_or_si128(_mm_and_si128(w0, keep012), _mm_and_si128(_mm_srli_si128(w0, 6), keep34)),
+                                            _mm_or_si128(_mm_and_si128(_mm_slli_si128(w1, 10), keep5), _mm_and_si128(_mm_slli_si128(w1, 4), keep67)));
+            const __m128i s1 = _mm_or_si128(_mm_and_si128(_mm_srli_si128(w1, 12), keep0), _mm_and_si128(_mm_srli_si128(w2, 2), keep123));
+
+            const __m128i result = _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(s0, two), 2), _mm_srli_epi16(_mm_add_epi16(s1, two), 2));
+            unsigned char* o = out + 3 * x;
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(o), result);
+            const int32 last = _mm_cvtsi128_si32(_mm_srli_si128(result, 8));
+            memcpy(o + 8, &last, 4);
+        }
+#endif
+        for (; x < dstWidth; ++x)
+        {
+            const unsigned char* p0 = row0 + 6 * x;
+            const unsigned char* p1 = row1 + 6 * x;
+            for (int32 c = 0; c < 3; ++c)
+                out[3 * x + c] = static_cast<unsigned char>((p0[c] + p0[c + 3] + p1[c] + p1[c + 3] + 2) >> 2);
+        }
+    }
+}
+
+
+enum EStreamPriority
+{
+    E_PRIORITY_LOW    = 0,
+    E_PRIORITY_NORMAL = 1,
+    E_PRIORITY_HIGH   = 2
+};
+
+
+static PString PriorityToString(int32 priority)
+{
+    switch (priority)
+    {
+    case E_PRIORITY_LOW : return "low";
+    case E_PRIORITY_HIGH: return "high";
+    default             : return "normal";
+    }
+}
+
+
+static int32 PriorityFromString(const PString& priority)
+{
+    if (priority == "low")  return E_PRIORITY_LOW;
+    if (priority == "high") return E_PRIORITY_HIGH;
+    return E_PRIORITY_NORMAL;
+}
+
+
+// Scheduling state of one stream; all members are protected by the mutex of SStreamScheduler
+struct SStreamSchedulingState
+{
+    SStreamSchedulingState()
+        : m_name                ()
+        , m_priority            (E_PRIORITY_NORMAL)
+        , m_decimation          (1)
+        , m_width               (0)
+        , m_height              (0)
+        , m_framesDecoded       (0)
+        , m_framesDelivered     (0)
+        , m_framesSkipped       (0)
+        , m_framesConsumed      (0)
+        , m_windowDecoded       (0)
+        , m_windowDelivered     (0)
+        , m_windowConsumed      (0)
+        , m_decodedFps          (0.0)
+        , m_deliveredFps        (0.0)
+        , m_consumedFps         (0.0)
+        , m_numAdjustments      (0)
+        , m_lastAdjustment      ()
+        , m_isDecodeReduced     (false)
+    {
+    }
+
+    // cost of the stream, estimated from the number of pixels decoded per second: a proxy which ignores the codec and the
+    // bitrate, libvlc does not report the time spent decoding each stream
+    double GetCost() const { return m_decodedFps * m_width * m_height; }
+
+    // true when the consumer picks up less than half of the frames we deliver
+    bool IsLagging() const { return m_deliveredFps > 0.0 && m_consumedFps < 0.5 * m_deliveredFps; }
+
+    PString m_name;
+    int32   m_priority;
+    int32   m_decimation;       //!< deliver 1 frame out of m_decimation
+    int32   m_width;
+    int32   m_height;
+    int64   m_framesDecoded;
+    int64   m_framesDelivered;
+    int64   m_framesSkipped;
+    int64   m_framesConsumed;
+    int32   m_windowDecoded;
+    int32   m_windowDelivered;
+    int32   m_windowConsumed;
+    double  m_decodedFps;
+    double  m_deliveredFps;
+    double  m_consumedFps;
+    int32   m_numAdjustments;
+    PString m_lastAdjustment;
+    bool    m_isDecodeReduced;  //!< the player runs with "avcodec-skip-frame", see SStreamScheduler::UpdateDecodeReduction()
+};
+
+
+// Process-wide scheduler shared by all the opened streams.
+// It measures the CPU load of the process and of the host (analytics may run in other processes, see "shm"), and when
+// the highest of both goes above SCHEDULER_HIGH_WATERMARK, lowers the delivered frame rate of the most expensive
+// low/normal-priority streams (lagging consumers first); high-priority streams are never throttled.
+// Frames are skipped after libvlc has decoded them, which only saves the work of the consumer: when decoding itself is the
+// bottleneck, streams throttled to 1/SCHEDULER_DECODE_SKIP_DECIMATION or less also have their decoder skip the non-reference
+// frames (player restarted by the consumer thread, see UpdateDecodeReduction()).
+class SStreamScheduler
+{
+public:
+    SStreamScheduler()
+        : m_mutex         ()
+        , m_streams       ()
+        , m_timer         ()
+        , m_lastWallInSec (0.0)
+        , m_lastCpuClock  (std::clock())
+        , m_lastHostCpu   ()
+        , m_hasHostCpu    (SHostCpuTimes::Get(m_lastHostCpu))
+        , m_numCores      (std::max(1u, std::thread::hardware_concurrency()))
+        , m_processLoad   (0.0)
+        , m_hostLoad      (-1.0)
+        , m_load          (0.0)
+        , m_numAdjustments(0)
+        , m_lastAdjustment()
+    {
+    }
+
+    static SStreamScheduler& GetInstance()
+    {
+        static SStreamScheduler s_scheduler;
+        return s_scheduler;
+    }
+
+    void Register(SStreamSchedulingState* state)
+    {
+        m_mutex.Lock();
+        m_streams.push_back(state);
+        m_mutex.Unlock();
+    }
+
+    void Unregister(SStreamSchedulingState* state)
+    {
+        m_mutex.Lock();
+        m_streams.remove(state);
+        m_mutex.Unlock();
+    }
+
+    // Called by the decoding thread for each frame; returns true if the frame must be delivered to the consumer
+    bool OnFrameDecoded(SStreamSchedulingState* state, int32 width, int32 height)
+    {
+        m_mutex.Lock();
+        state->m_width  = width;
+        state->m_height = height;
+        const bool isDelivered = (state->m_framesDecoded % state->m_decimation) == 0;
+        state->m_framesDecoded++;
+        state->m_windowDecoded++;
+        if (isDelivered)
+        {
+            state->m_framesDelivered++;
+            state->m_windowDelivered++;
+        }
+        else
+        {
+            state->m_framesSkipped++;
+        }
+        if (m_timer.ElapsedSec() - m_lastWallInSec >= SCHEDULER_PERIOD_IN_SEC)
+            Evaluate();
+        m_mutex.Unlock();
+        return isDelivered;
+    }
+
+    void OnFrameConsumed(SStreamSchedulingState* state)
+    {
+        m_mutex.Lock();
+        state->m_framesConsumed++;
+        state->m_windowConsumed++;
+        m_mutex.Unlock();
+    }
+
+    void GetStreamProperties(const SStreamSchedulingState* state, PProperties& properties)
+    {
+        m_mutex.Lock();
+        properties.Set("priority"       , PriorityToString(state->m_priority));
+        properties.Set("decimation"     , state->m_decimation);
+        properties.Set("framesDecoded"  , state->m_framesDecoded);
+        properties.Set("framesDelivered", state->m_framesDelivered);
+        properties.Set("framesSkipped"  , state->m_framesSkipped);
+        properties.Set("framesConsumed" , state->m_framesConsumed);
+        properties.Set("decodedFps"     , state->m_decodedFps);
+        properties.Set("deliveredFps"   , state->m_deliveredFps);
+        properties.Set("consumedFps"    , state->m_consumedFps);
+        properties.Set("isLagging"      , state->IsLagging());
+        properties.Set("numAdjustments" , state->m_numAdjustments);
+        properties.Set("lastAdjustment" , state->m_lastAdjustment);
+        properties.Set("isDecodeReduced", state->m_isDecodeReduced);
+        m_mutex.Unlock();
+    }
+
+    // Called by the consumer thread: the decoder of a stream throttled to 1/SCHEDULER_DECODE_SKIP_DECIMATION or less must skip
+    // the non-reference frames, and decode all of them again only once the stream is fully restored (hysteresis, each change
+    // restarts the player). Returns true, and records the new state, when the player must be restarted.
+    bool UpdateDecodeReduction(SStreamSchedulingState* state)
+    {
+        m_mutex.Lock();
+        const bool isReduced = state->m_isDecodeReduced ? state->m_decimation > 1 : state->m_decimation >= SCHEDULER_DECODE_SKIP_DECIMATION;
+        const bool isChanged = isReduced != state->m_isDecodeReduced;
+        if (isChanged)
+        {
+            state->m_isDecodeReduced = isReduced;
+            P_LOG_INFO << PRODUCT_NAME << ": scheduler: " << state->m_name << ": decoder " << (isReduced ? "skips" : "decodes") << " non-reference frames"
+                       << " (frame rate 1/" << state->m_decimation << ")";
+        }
+        m_mutex.Unlock();
+        return isChanged;
+    }
+
+    bool IsDecodeReduced(const SStreamSchedulingState* state)
+    {
+        m_mutex.Lock();
+        const bool isReduced = state->m_isDecodeReduced;
+        m_mutex.Unlock();
+        return isReduced;
+    }
+
+    void GetProperties(PProperties& properties)
+    {
+        m_mutex.Lock();
+        int32 numThrottled     = 0;
+        int32 numDecodeReduced = 0;
+        for (std::list<SStreamSchedulingState*>::const_iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            if ((*it)->m_decimation > 1)
+                ++numThrottled;
+            if ((*it)->m_isDecodeReduced)
+                ++numDecodeReduced;
+        }
+        properties.Set("load"            , m_load);
+        properties.Set("processLoad"     , m_processLoad);
+        properties.Set("hostLoad"        , m_hostLoad);
+        properties.Set("numCores"        , int32(m_numCores));
+        properties.Set("numStreams"      , int32(m_streams.size()));
+        properties.Set("numThrottled"    , numThrottled);
+        properties.Set("numDecodeReduced", numDecodeReduced);
+        properties.Set("numAdjustments"  , m_numAdjustments);
+        properties.Set("lastAdjustment"  , m_lastAdjustment);
+        m_mutex.Unlock();
+    }
+
+private:
+    // m_mutex must be locked
+    void Evaluate()
+    {
+        const double  wallInSec  = m_timer.ElapsedSec();
+        const std::clock_t cpu   = std::clock();
+        const double  elapsed    = wallInSec - m_lastWallInSec;
+        m_processLoad   = double(cpu - m_lastCpuClock) / CLOCKS_PER_SEC / (elapsed * m_numCores);
+        m_lastWallInSec = wallInSec;
+        m_lastCpuClock  = cpu;
+
+        // an overcommitted host counts even if this process looks idle
+        SHostCpuTimes hostCpu;
+        if (m_hasHostCpu && SHostCpuTimes::Get(hostCpu) && hostCpu.m_total > m_lastHostCpu.m_total)
+        {
+            m_hostLoad    = double(hostCpu.m_busy - m_lastHostCpu.m_busy) / double(hostCpu.m_total - m_lastHostCpu.m_total);
+            m_lastHostCpu = hostCpu;
+        }
+        m_load = std::max(m_processLoad, m_hostLoad);
+
+        for (std::list<SStreamSchedulingState*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+        {
+            SStreamSchedulingState* s = *it;
+            s->m_decodedFps      = s->m_windowDecoded   / elapsed;
+            s->m_deliveredFps    = s->m_windowDelivered / elapsed;
+            s->m_consumedFps     = s->m_windowConsumed  / elapsed;
+            s->m_windowDecoded   = 0;
+            s->m_windowDelivered = 0;
+            s->m_windowConsumed  = 0;
+        }
+
+        // the further the load is from the watermark, the more streams are adjusted in this period (each one at most once),
+        // up to SCHEDULER_MAX_ADJUSTED_FRACTION of the candidates, so that hundreds of streams are relieved in a few periods
+        if (m_load > SCHEDULER_HIGH_WATERMARK)
+        {
+            std::vector<SStreamSchedulingState*> candidates;
+            for (std::list<SStreamSchedulingState*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+                if ((*it)->m_priority != E_PRIORITY_HIGH && (*it)->m_decimation < SCHEDULER_MAX_DECIMATION)
+                    candidates.push_back(*it);
+            std::sort(candidates.begin(), candidates.end(), IsBetterThrottlingCandidate);
+
+            const double overload = std::min(1.0, (m_load - SCHEDULER_HIGH_WATERMARK) / (1.0 - SCHEDULER_HIGH_WATERMARK));
+            const size_t count    = GetNumAdjustments(overload, candidates.size());
+            for (size_t i = 0; i < count; ++i)
+                Adjust(candidates[i], candidates[i]->m_decimation * 2, "overload");
+        }
+        else if (m_load < SCHEDULER_LOW_WATERMARK)
+        {
+            std::vector<SStreamSchedulingState*> candidates;
+            for (std::list<SStreamSchedulingState*>::iterator it = m_streams.begin(); it != m_streams.end(); ++it)
+                if ((*it)->m_decimation > 1)
+                    candidates.push_back(*it);
+            std::sort(candidates.begin(), candidates.end(), IsBetterRestoringCandidate);
+
+            const double underload = (SCHEDULER_LOW_WATERMARK - m_load) / SCHEDULER_LOW_WATERMARK;
+            const size_t count     = GetNumAdjustments(underload, candidates.size());
+            for (size_t i = 0; i < count; ++i)
+                Adjust(candidates[i], candidates[i]->m_decimation / 2, "recovered");
+        }
+    }
+
+    // distance (0..1) from the watermark -> number of candidates to adjust, at least one
+    static size_t GetNumAdjustments(double distance, size_t numCandidates)
+    {
+        const size_t count = size_t(std::ceil(distance * SCHEDULER_MAX_ADJUSTED_FRACTION * numCandidates));
+        return std::min(numCandidates, std::max(size_t(1), count));
+    }
+
+    // highest priority first
+    static bool IsBetterRestoringCandidate(const SStreamSchedulingState* a, const SStreamSchedulingState* b)
+    {
+        return a->m_priority > b->m_priority;
+    }
+
+    // lowest priority first, then lagging consumers, then most expensive stream
+    static bool IsBetterThrottlingCandidate(const SStreamSchedulingState* a, const SStreamSchedulingState* b)
+    {
+        if (a->m_priority != b->m_priority)
+            return a->m_priority < b->m_priority;
+        if (a->IsLagging() != b->IsLagging())
+            return a->IsLagging();
+        return a->GetCost() > b->GetCost();
+    }
+
+    void Adjust(SStreamSchedulingState* state, int32 decimation, const PString& reason)
+    {
+        state->m_lastAdjustment = PString("%1: load %2, frame rate 1/%3 -> 1/%4").Arg(reason).Arg(m_load).Arg(state->m_decimation).Arg(decimation);
+        P_LOG_INFO << PRODUCT_NAME << ": scheduler: " << state->m_name << ": " << state->m_lastAdjustment;
+        state->m_decimation = decimation;
+        state->m_numAdjustments++;
+        m_lastAdjustment = PString("%1: %2").Arg(state->m_name).Arg(state->m_lastAdjustment);
+        m_numAdjustments++;
+    }
+
+    PMutex                             m_mutex;
+    std::list<SStreamSchedulingState*> m_streams;
+    PTimer                             m_timer;
+    double                             m_lastWallInSec;
+    std::clock_t                       m_lastCpuClock;
+    SHostCpuTimes                      m_lastHostCpu;
+    bool                               m_hasHostCpu;
+    unsigned int                       m_numCores;
+    double                             m_processLoad;
+    double                             m_hostLoad;         //!< -1 if unknown (not Linux)
+    double                             m_load;             //!< max of m_processLoad and m_hostLoad
+    int32                              m_numAdjustments;
+    PString                            m_lastAdjustment;
+};
+
+
+enum ELatencyProfile
+{
+    E_LATENCY_DEFAULT  = 0, //!< fixed network caching (DEFAULT_NETWORK_CACHING_IN_MS or "network-caching")
+    E_LATENCY_LOW      = 1, //!< minimal caching, late frames dropped, no clock jitter compensation
+    E_LATENCY_ADAPTIVE = 2  //!< like E_LATENCY_LOW but network caching tuned from the observed inter-arrival jitter
+};
+
+
+static PString LatencyProfileToString(int32 profile)
+{
+    switch (profile)
+    {
+    case E_LATENCY_LOW     : return "low";
+    case E_LATENCY_ADAPTIVE: return "adaptive";
+    default                : return "default";
+    }
+}
+
+
+// Measures the latency of a stream (all times in ms).
+// The vmem callbacks of libvlc are called when the picture is rendered, i.e. after the network cache and the clock: the
+// jitter of the output intervals measured there is what the cache did not absorb, not the jitter of the network. The
+// adaptive network caching is therefore driven by the frames libvlc itself drops for being late (input statistics of the
+// media): when more than ADAPTIVE_MAX_LATE_FRACTION of the frames of a window are lost, the caching is doubled. It is never
+// lowered again, so the player cannot oscillate between two values.
+struct SLatencyState
+{
+    SLatencyState()
+        : m_mutex                  ()
+        , m_timer                  ()
+        , m_numFrames              (0)
+        , m_lastOutputMs           (-1.0)
+        , m_lastDecodedMs          (-1.0)
+        , m_meanOutputIntervalMs   (0.0)
+        , m_outputJitterMs         (0.0)
+        , m_decodeToDeliveryMs     (0.0)
+        , m_lastDecodeToDeliveryMs (0.0)
+        , m_numRetunes             (0)
+        , m_lastStatsInSec         (0.0)
+        , m_windowDisplayed        (-1)
+        , m_windowLost             (-1)
+        , m_numLostPictures        (0)
+        , m_lateFraction           (0.0)
+    {
+    }
+
+    double NowMs() { return m_timer.ElapsedSec() * 1000.0; }
+
+    // called when the player is (re)started: libvlc counts the statistics of the new media from 0
+    void Reset()
+    {
+        m_mutex.Lock();
+        m_numFrames       = 0;
+        m_lastOutputMs    = -1.0;
+        m_lastDecodedMs   = -1.0;
+        m_outputJitterMs  = 0.0;
+        m_windowDisplayed = -1;
+        m_windowLost      = -1;
+        m_numLostPictures = 0;
+        m_mutex.Unlock();
+    }
+
+    // called by the decoding thread for every frame rendered by libvlc, delivered or not: skipping frames (see SStreamScheduler)
+    // must not inflate the output interval
+    void OnFrameOutput()
+    {
+        m_mutex.Lock();
+        const double now = NowMs();
+        if (m_lastOutputMs >= 0.0)
+        {
+            // same estimator as RFC 3550: smoothed deviation of the interval around its mean
+            const double interval = now - m_lastOutputMs;
+            if (m_numFrames == 1)
+                m_meanOutputIntervalMs = interval;
+            const double deviation = interval > m_meanOutputIntervalMs ? interval - m_meanOutputIntervalMs : m_meanOutputIntervalMs - interval;
+            m_outputJitterMs       += (deviation - m_outputJitterMs)       / 16.0;
+            m_meanOutputIntervalMs += (interval  - m_meanOutputIntervalMs) / 16.0;
+        }
+        m_lastOutputMs = now;
+        m_numFrames++;
+        m_mutex.Unlock();
+    }
+
+    // called by the decoding thread for each frame handed to the consumer
+    void OnFrameDecoded()
+    {
+        m_mutex.Lock();
+        m_lastDecodedMs = NowMs();
+        m_mutex.Unlock();
+    }
+
+    // called by the consumer when the last decoded frame is returned
+    void OnFrameDelivered()
+    {
+        m_mutex.Lock();
+        if (m_lastDecodedMs >= 0.0)
+        {
+            m_lastDecodeToDeliveryMs = NowMs() - m_lastDecodedMs;
+            m_decodeToDeliveryMs    += (m_lastDecodeToDeliveryMs - m_decodeToDeliveryMs) / 16.0;
+        }
+        m_mutex.Unlock();
+    }
+
+    // true when the input statistics are due (every ADAPTIVE_STATS_PERIOD_IN_SEC)
+    bool IsStatsDue(double nowInSec)
+    {
+        m_mutex.Lock();
+        const bool isDue = nowInSec - m_lastStatsInSec >= ADAPTIVE_STATS_PERIOD_IN_SEC;
+        if (isDue)
+            m_lastStatsInSec = nowInSec;
+        m_mutex.Unlock();
+        return isDue;
+    }
+
+    // Takes the counters of displayed and lost (late) pictures of the media; returns the network caching which the late frames
+    // call for, or 0 if the current one is fine or the window does not hold enough frames yet
+    int32 OnInputStats(int32 networkCachingInMs, int32 numDisplayed, int32 numLost)
+    {
+        m_mutex.Lock();
+        int32 caching = 0;
+        m_numLostPictures = numLost;
+        if (m_windowDisplayed < 0 || numDisplayed < m_windowDisplayed || numLost < m_windowLost)
+        {
+            m_windowDisplayed = numDisplayed;
+            m_windowLost      = numLost;
+        }
+        else if ((numDisplayed - m_windowDisplayed) + (numLost - m_windowLost) >= ADAPTIVE_MIN_FRAMES)
+        {
+            const int32 lost = numLost - m_windowLost;
+            m_lateFraction    = double(lost) / double((numDisplayed - m_windowDisplayed) + lost);
+            m_windowDisplayed = numDisplayed;
+            m_windowLost      = numLost;
+            if (m_lateFraction > ADAPTIVE_MAX_LATE_FRACTION && networkCachingInMs < MAX_NETWORK_CACHING_IN_MS)
+                caching = std::min(2 * networkCachingInMs, MAX_NETWORK_CACHING_IN_MS);
+        }
+        m_mutex.Unlock();
+        return caching;
+    }
+
+    // glass-to-frame latency is estimated as the time spent in the network cache plus the time spent waiting for the consumer;
+    // the capture time is unknown to libvlc, so it cannot be measured directly
+    void GetProperties(int32 profile, int32 networkCachingInMs, PProperties& properties)
+    {
+        m_mutex.Lock();
+        properties.Set("profile"               , LatencyProfileToString(profile));
+        properties.Set("networkCachingMs"      , networkCachingInMs);
+        properties.Set("outputJitterMs"        , m_outputJitterMs);
+        properties.Set("meanOutputIntervalMs"  , m_meanOutputIntervalMs);
+        properties.Set("numLostPictures"       , m_numLostPictures);
+        properties.Set("lateFraction"          , m_lateFraction);
+        properties.Set("decodeToDeliveryMs"    , m_decodeToDeliveryMs);
+        properties.Set("lastDecodeToDeliveryMs", m_lastDecodeToDeliveryMs);
+        properties.Set("glassToFrameEstimateMs", networkCachingInMs + m_decodeToDeliveryMs);
+        properties.Set("numRetunes"            , m_numRetunes);
+        m_mutex.Unlock();
+    }
+
+    PMutex  m_mutex;
+    PTimer  m_timer;
+    int32   m_numFrames;
+    double  m_lastOutputMs;
+    double  m_lastDecodedMs;
+    double  m_meanOutputIntervalMs;
+    double  m_outputJitterMs;          //!< jitter left after the network cache, not the network jitter
+    double  m_decodeToDeliveryMs;
+    double  m_lastDecodeToDeliveryMs;
+    int32   m_numRetunes;
+    double  m_lastStatsInSec;
+    int32   m_windowDisplayed;         //!< counters of the media at the start of the current late-frame window, -1 if unknown
+    int32   m_windowLost;
+    int32   m_numLostPictures;
+    double  m_lateFraction;            //!< fraction of the frames lost for being late in the last complete window
+};
+
+
+enum EHugePages
+{
+    E_HUGE_PAGES_OFF = 0,
+    E_HUGE_PAGES_TRANSPARENT,   //!< madvise(MADV_HUGEPAGE), the kernel backs the slabs with huge pages when it can
+    E_HUGE_PAGES_EXPLICIT       //!< MAP_HUGETLB from the reserved pool (vm.nr_hugepages), transparent if the pool is empty
+};
+
+
+static PString HugePagesToString(int32 hugePages)
+{
+    switch (hugePages)
+    {
+    case E_HUGE_PAGES_TRANSPARENT: return "transparent";
+    case E_HUGE_PAGES_EXPLICIT   : return "explicit";
+    default                      : return "off";
+    }
+}
+
+
+// Frame memory handed out by SFrameArena
+struct SFrameSlab
+{
+    SFrameSlab()
+        : m_data     (NULL)
+        , m_size     (0)
+        , m_classSize(0)
+    {
+    }
+
+    unsigned char* m_data;
+    size_t         m_size;      //!< bytes requested
+    size_t         m_classSize; //!< bytes reserved, i.e. size class of the slab
+};
+
+
+// Process-wide arena of the frame buffers of all the streams.
+// Slabs are 64-byte aligned (page aligned in practice), optionally backed by huge pages (Linux), and grouped into size classes:
+// the footprint of a frame geometry rounded up to the page size (to the huge page size only for explicit huge pages, and only
+// for slabs of at least one huge page). A slab given back by a stream is kept in the free list of its class, up to
+// FRAME_ARENA_MAX_CACHED_SLABS_PER_CLASS, and reused by the next stream with the same geometry, so hundreds of cameras of the
+// same model do not fragment the heap. There is no cap by default; when one is set, reserved memory (used + cached) never
+// exceeds it and cached slabs of other classes are unmapped first.
+// The cap and the huge pages mode are read from the environment, see DocIVSVLC.h.
+class SFrameArena
+{
+public:
+    SFrameArena()
+        : m_mutex              ()
+        , m_classes            ()
+        , m_capInBytes         (DEFAULT_FRAME_ARENA_CAP_IN_MB * 1024 * 1024)
+        , m_hugePages          (E_HUGE_PAGES_OFF)
+        , m_reservedBytes      (0)
+        , m_usedBytes          (0)
+        , m_peakBytes          (0)
+        , m_numSlabs           (0)
+        , m_numFailures        (0)
+        , m_numHugeTlbFallbacks(0)
+    {
+        const char* cap = getenv("PAPILLON_VLC_FRAME_ARENA_CAP_MB");
+        if (cap != NULL && atoi(cap) > 0)
+            m_capInBytes = int64(atoi(cap)) * 1024 * 1024;
+#ifdef PAPILLON_LINUX
+        m_hugePages = E_HUGE_PAGES_TRANSPARENT;
+        const char* hugePages = getenv("PAPILLON_VLC_HUGE_PAGES");
+        if (hugePages != NULL)
+        {
+            if      (strcmp(hugePages, "off"     ) == 0) m_hugePages = E_HUGE_PAGES_OFF;
+            else if (strcmp(hugePages, "explicit") == 0) m_hugePages = E_HUGE_PAGES_EXPLICIT;
+        }
+#endif
+        P_LOG_INFO << PRODUCT_NAME << ": frame arena: cap " << (m_capInBytes == 0 ? PString("none") : PString("%1 MB").Arg(m_capInBytes / (1024 * 1024)))
+                   << ", huge pages " << HugePagesToString(m_hugePages);
+    }
+
+    static SFrameArena& GetInstance()
+    {
+        static SFrameArena s_arena;
+        return s_arena;
+    }
+
+    // Transparent huge pages need no rounding: the kernel backs the aligned 2 MB ranges of a slab, the tail stays in small pages
+    size_t GetClassSize(size_t size) const
+    {
+        const size_t granularity = IsHugeTlb(size) ? FRAME_ARENA_HUGE_PAGE_SIZE : FRAME_ARENA_PAGE_SIZE;
+        return (size + granularity - 1) / granularity * granularity;
+    }
+
+    // Makes slab hold at least size bytes; the slab is only replaced when the size class changes.
+    // Returns false, and leaves the slab untouched, if the cap would be exceeded.
+    bool Resize(SFrameSlab& slab, size_t size)
+    {
+        const size_t classSize = GetClassSize(std::max(size, size_t(1)));
+        if (slab.m_data != NULL && slab.m_classSize == classSize)
+        {
+            slab.m_size = size;
+            return true;
+        }
+
+        m_mutex.Lock();
+        unsigned char* data = NULL;
+        std::vector<unsigned char*>& freeSlabs = m_classes[classSize];
+        if (!freeSlabs.empty())
+        {
+            data = freeSlabs.back();
+            freeSlabs.pop_back();
+        }
+        else
+        {
+            TrimCache(int64(classSize));
+            if (m_capInBytes == 0 || m_reservedBytes + int64(classSize) <= m_capInBytes)
+                data = Map(classSize);
+            if (data != NULL)
+            {
+                m_reservedBytes += int64(classSize);
+                ONBENCH(BenchCountMapping());
+            }
+        }
+
+        if (data == NULL)
+        {
+            m_numFailures++;
+            m_mutex.Unlock();
+            P_LOG_ERROR << PRODUCT_NAME << ": frame arena: cannot allocate " << int64(classSize) << " bytes (cap " << m_capInBytes / (1024 * 1024)
+                        << " MB, 0 for none, see PAPILLON_VLC_FRAME_ARENA_CAP_MB)";
+            return false;
+        }
+
+        m_usedBytes += int64(classSize);
+        m_peakBytes  = std::max(m_peakBytes, m_usedBytes);
+        m_numSlabs++;
+        ReleaseLocked(slab);
+        m_mutex.Unlock();
+
+        slab.m_data      = data;
+        slab.m_size      = size;
+        slab.m_classSize = classSize;
+        return true;
+    }
+
+    // Gives the slab back to the free list of its class
+    void Release(SFrameSlab& slab)
+    {
+        if (slab.m_data == NULL)
+            return;
+        m_mutex.Lock();
+        ReleaseLocked(slab);
+        m_mutex.Unlock();
+        slab = SFrameSlab();
+    }
+
+    void GetProperties(PProperties& properties)
+    {
+        m_mutex.Lock();
+        int32 numCachedSlabs = 0;
+        for (std::map<size_t, std::vector<unsigned char*> >::const_iterator it = m_classes.begin(); it != m_classes.end(); ++it)
+            numCachedSlabs += int32(it->second.size());
+        properties.Set("capBytes"           , m_capInBytes);
+        properties.Set("reservedBytes"      , m_reservedBytes);
+        properties.Set("usedBytes"          , m_usedBytes);
+        properties.Set("cachedBytes"        , m_reservedBytes - m_usedBytes);
+        properties.Set("peakBytes"          , m_peakBytes);
+        properties.Set("numSlabs"           , m_numSlabs);
+        properties.Set("numCachedSlabs"     , numCachedSlabs);
+        properties.Set("numClasses"         , int32(m_classes.size()));
+        properties.Set("numFailures"        , m_numFailures);
+        properties.Set("numHugeTlbFallbacks", m_numHugeTlbFallbacks);
+        properties.Set("hugePages"          , HugePagesToString(m_hugePages));
+        properties.Set("alignment"          , int32(FRAME_ARENA_ALIGNMENT));
+        m_mutex.Unlock();
+    }
+
+private:
+    void ReleaseLocked(const SFrameSlab& slab)
+    {
+        if (slab.m_data == NULL)
+            return;
+        std::vector<unsigned char*>& freeSlabs = m_classes[slab.m_classSize];
+        if (freeSlabs.size() < FRAME_ARENA_MAX_CACHED_SLABS_PER_CLASS)
+        {
+            freeSlabs.push_back(slab.m_data);
+        }
+        else
+        {
+            Unmap(slab.m_data, slab.m_classSize);
+            m_reservedBytes -= int64(slab.m_classSize);
+        }
+        m_usedBytes -= int64(slab.m_classSize);
+        m_numSlabs--;
+    }
+
+    // MAP_HUGETLB needs a multiple of the huge page size: only worth it for slabs of at least one huge page
+    bool IsHugeTlb(size_t size) const
+    {
+        return m_hugePages == E_HUGE_PAGES_EXPLICIT && size >= FRAME_ARENA_HUGE_PAGE_SIZE;
+    }
+
+    // Unmaps cached slabs until size more bytes fit under the cap
+    void TrimCache(int64 size)
+    {
+        if (m_capInBytes == 0)
+            return;
+        for (std::map<size_t, std::vector<unsigned char*> >::iterator it = m_classes.begin(); it != m_classes.end(); ++it)
+        {
+            while (m_reservedBytes + size > m_capInBytes && !it->second.empty())
+            {
+                Unmap(it->second.back(), it->first);
+                it->second.pop_back();
+                m_reservedBytes -= int64(it->first);
+            }
+        }
+    }
+
+    unsigned char* Map(size_t size)
+    {
+#ifdef PAPILLON_LINUX
+#   ifdef MAP_HUGETLB
+        if (IsHugeTlb(size))
+        {
+            void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (memory != MAP_FAILED)
+                return static_cast<unsigned char*>(memory);
+            m_numHugeTlbFallbacks++;
+        }
+#   endif
+        if (m_hugePages == E_HUGE_PAGES_OFF || size < FRAME_ARENA_HUGE_PAGE_SIZE)
+        {
+            void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return memory != MAP_FAILED ? static_cast<unsigned char*>(memory) : NULL;
+        }
+
+        // over-map to align the slab on a huge page, so that the kernel can back each of its whole 2 MB ranges with a huge page
+        void* memory = mmap(NULL, size + FRAME_ARENA_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return NULL;
+        unsigned char* begin   = static_cast<unsigned char*>(memory);
+        unsigned char* aligned = reinterpret_cast<unsigned char*>((reinterpret_cast<uintptr_t>(begin) + FRAME_ARENA_HUGE_PAGE_SIZE - 1) & ~uintptr_t(FRAME_ARENA_HUGE_PAGE_SIZE - 1));
+        if (aligned != begin)
+            munmap(begin, aligned - begin);
+        if (aligned + size != begin + size + FRAME_ARENA_HUGE_PAGE_SIZE)
+            munmap(aligned + size, (begin + size + FRAME_ARENA_HUGE_PAGE_SIZE) - (aligned + size));
+#   ifdef MADV_HUGEPAGE
+        madvise(aligned, size, MADV_HUGEPAGE);
+#   endif
+        return aligned;
+#elif defined(_WIN32)
+        return static_cast<unsigned char*>(_aligned_malloc(size, FRAME_ARENA_ALIGNMENT));
+#else
+        void* memory = NULL;
+        return posix_memalign(&memory, FRAME_ARENA_ALIGNMENT, size) == 0 ? static_cast<unsigned char*>(memory) : NULL;
+#endif
+    }
+
+    void Unmap(unsigned char* data, size_t size)
+    {
+#ifdef PAPILLON_LINUX
+        munmap(data, size);
+#elif defined(_WIN32)
+        (void)size;
+        _aligned_free(data);
+#else
+        (void)size;
+        free(data);
+#endif
+    }
+
+    PMutex                                        m_mutex;
+    std::map<size_t, std::vector<unsigned char*> > m_classes;            //!< free slabs of each size class
+    int64                                         m_capInBytes;
+    int32                                         m_hugePages;
+    int64                                         m_reservedBytes;      //!< used + cached
+    int64                                         m_usedBytes;
+    int64                                         m_peakBytes;
+    int32                                         m_numSlabs;           //!< slabs in use
+    int32                                         m_numFailures;        //!< allocations refused because of the cap
+    int32                                         m_numHugeTlbFallbacks;
+};
+
+
 struct SInputStream
 {
 public:
@@ -108,28 +1045,53 @@ public:
         , m_libvlc_event_manager                    (NULL)
         , m_libvlc_media_list                       (NULL)
         , m_mutexPixelBuffer                        ()
-        , m_pixelBuffer                             ()
-        , m_queue                                   (MAX_PENDING_IMAGES, 0)
+        , m_pixelSlab                               ()
+        , m_mutexQueue                              ()
+        , m_readySlab                               ()
+        , m_readyWidth                              (0)
+        , m_readyHeight                             (0)
         , m_imgWidth                                (DEFAULT_WIDTH)
         , m_imgHeight                               (DEFAULT_HEIGHT)
         , m_networkCachingInMs                      (DEFAULT_NETWORK_CACHING_IN_MS)
+        , m_isNetworkCachingExplicit                (false)
         , m_protocol                                (DEFAULT_PROTOCOL)
         , m_isRGBSwapped                            (false)
         , m_libvlc_event_mediaPlayerEndReached      (false)
         , m_libvlc_event_mediaPlayerEncounteredError(false)
         , m_libvlc_event_mediaPlayerPlaying         (false)
         , m_frameNumber                             (0)
+        , m_scheduling                              ()
+        , m_isScheduled                             (false)
+        , m_latencyProfile                          (E_LATENCY_DEFAULT)
+        , m_latency                                 ()
+        , m_lastRestartInSec                        (0.0)
+        , m_mutexEvents                             ()
+        , m_eventOccurred                           ()
+        , m_numFramesProduced                       (0)
+        , m_numPyramidLevels                        (0)
+        , m_formatWidth                             (0)
+        , m_formatHeight                            (0)
+        , m_bufferSize                              (0)
+        , m_deliverySlab                            ()
+        , m_pyramid                                 ()
+        , m_isLicenseCheckedOut                     (false)
+        , m_sharedMemoryName                        ()
+        , m_sharedMemorySlots                       (DEFAULT_SHARED_MEMORY_SLOTS)
+#if USE_SHARED_MEMORY
+        , m_sharedMemory                            ()
+#endif
     {
     }
 
     ~SInputStream()
     {
+        ReleaseBuffers();
     }
 
     void* LockPixelBuffer()
     {
         m_mutexPixelBuffer.Lock();
-        return m_pixelBuffer.AsPtr<void>();
+        return m_pixelSlab.m_data;
     }
 
     void UnlockPixelBuffer()
@@ -137,87 +1099,440 @@ public:
         m_mutexPixelBuffer.Unlock();
     }
 
-    void SetResolution(int width, int height)
+    void SetResolution(int width, int height)
+    {
+        if ((width == 0) || (height == 0))
+        {
+            P_LOG_FATAL << "bad resolution (width and height must not be 0)";
+            return;
+        }
+
+        P_LOG_INFO << PRODUCT_NAME << ": setting resolution to " << width << "x" << height;
+
+        m_imgWidth  = width%16 == 0 ? width : width + 16 - width%16;
+        m_imgHeight = height;
+
+        ResizeBuffers(m_imgWidth, m_imgHeight, false);
+    }
+
+    // Size of a frame followed by its pyramid levels
+    int32 GetBufferSize(int32 width, int32 height) const
+    {
+        int32 size = width * height * 3;
+        for (int32 level = 1; level <= m_numPyramidLevels; ++level)
+            size += (width >> level) * (height >> level) * 3;
+        return size;
+    }
+
+    // The pixel buffer comes from the frame arena; if the arena cap is reached, the previous buffer is kept and false is returned.
+    // isFormat is true for the geometry libvlc writes with (see CallbackFormat): once it is known, the buffer always holds it and
+    // other resizes (SetResolution) are ignored, libvlc would overrun a smaller pixel buffer
+    bool ResizeBuffers(int32 width, int32 height, bool isFormat)
+    {
+        const int32 sizeOfBuffer = GetBufferSize(width, height);
+
+        LockPixelBuffer();
+        if (!isFormat && m_formatWidth != 0)
+        {
+            UnlockPixelBuffer();
+            return true;
+        }
+        const bool isResized = SFrameArena::GetInstance().Resize(m_pixelSlab, size_t(sizeOfBuffer));
+        if (isResized && isFormat)
+        {
+            m_formatWidth  = width;
+            m_formatHeight = height;
+        }
+        if (isResized)
+            m_bufferSize = sizeOfBuffer;
+        UnlockPixelBuffer();
+        return isResized;
+    }
+
+    // Gives the frame buffers back to the arena; the player must be stopped
+    void ReleaseBuffers()
+    {
+        LockPixelBuffer();
+        SFrameArena::GetInstance().Release(m_pixelSlab);
+        m_formatWidth  = 0;
+        m_formatHeight = 0;
+        m_bufferSize   = 0;
+        m_mutexQueue.Lock();
+        SFrameArena::GetInstance().Release(m_readySlab);
+        m_readyWidth  = 0;
+        m_readyHeight = 0;
+        SFrameArena::GetInstance().Release(m_deliverySlab);
+        m_mutexQueue.Unlock();
+        UnlockPixelBuffer();
+    }
+
+    // Computes the pyramid levels behind the frame in the pixel buffer; m_mutexPixelBuffer must be locked
+    void BuildPyramid()
+    {
+        if (m_numPyramidLevels == 0 || m_formatWidth == 0)
+            return;
+
+        unsigned char* src = m_pixelSlab.m_data;
+        int32 width  = m_formatWidth;
+        int32 height = m_formatHeight;
+        for (int32 level = 1; level <= m_numPyramidLevels; ++level)
+        {
+            unsigned char* dst = src + width * height * 3;
+            DownscaleBox2x2(src, width, height, dst);
+            src     = dst;
+            width  /= 2;
+            height /= 2;
+        }
+    }
+
+    // (Re-)creates the shared-memory ring when the frames do not fit in it anymore
+    void OpenSharedMemory()
+    {
+#if USE_SHARED_MEMORY
+        if (m_sharedMemoryName.IsEmpty())
+            return;
+
+        const uint32_t frameSize = uint32_t(m_formatWidth * m_formatHeight * 3);
+        LockPixelBuffer();
+        if (!m_sharedMemory.IsOpened() || frameSize > m_sharedMemory.GetHeader()->m_dataCapacity)
+        {
+            if (m_sharedMemory.Create(m_sharedMemoryName.c_str(), uint32_t(m_sharedMemorySlots), frameSize))
+                P_LOG_INFO << PRODUCT_NAME << ": shared memory " << m_sharedMemoryName.Quote() << " created: " << m_sharedMemorySlots << " slots of " << m_formatWidth << "x" << m_formatHeight;
+            else
+                P_LOG_ERROR << PRODUCT_NAME << ": failed to create shared memory " << m_sharedMemoryName.Quote() << ": " << PString(strerror(errno));
+        }
+        UnlockPixelBuffer();
+#endif
+    }
+
+    // Copies the frame in the pixel buffer into the shared-memory ring; m_mutexPixelBuffer must be locked
+    void PublishToSharedMemory()
+    {
+#if USE_SHARED_MEMORY
+        if (!m_sharedMemory.IsOpened())
+            return;
+
+        const int64 ptsUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        const uint32_t frameSize = uint32_t(m_formatWidth * m_formatHeight * 3);
+        ONBENCH(if (int32(frameSize) <= m_bufferSize) BenchCountCopy(int32(frameSize)));
+        if (int32(frameSize) <= m_bufferSize)
+            m_sharedMemory.Publish(uint64_t(m_numFramesProduced), ptsUs, m_formatWidth, m_formatHeight, m_formatWidth * 3, "RV24", m_pixelSlab.m_data, frameSize);
+#endif
+    }
+
+    void CloseSharedMemory()
+    {
+#if USE_SHARED_MEMORY
+        LockPixelBuffer();
+        m_sharedMemory.Close();
+        UnlockPixelBuffer();
+#endif
+    }
+
+    // Hands the frame in the pixel buffer and its pyramid levels over to the consumer; m_mutexPixelBuffer must be locked.
+    // The three slabs of the stream rotate instead of being copied: the pixel buffer becomes the ready one, replacing a frame the
+    // consumer did not take yet (newest wins), and the former ready slab, resized to the current format, becomes the pixel
+    // buffer. If the arena cannot resize it, the frame is dropped.
+    void EnqueueFrame()
+    {
+        if (m_formatWidth == 0)
+            return;
+        m_mutexQueue.Lock();
+        if (SFrameArena::GetInstance().Resize(m_readySlab, size_t(m_bufferSize)))
+        {
+            std::swap(m_pixelSlab, m_readySlab);
+            m_readyWidth  = m_formatWidth;
+            m_readyHeight = m_formatHeight;
+        }
+        m_mutexQueue.Unlock();
+    }
+
+    // Takes the ready frame, if any, without waiting: copies it into image and its pyramid levels into m_pyramid.
+    // image is reallocated if its geometry is not the one of the frame.
+    bool TryDequeueImage(PImage& image)
     {
-        if ((width == 0) || (height == 0))
+        m_mutexQueue.Lock();
+        const int32 width  = m_readyWidth;
+        const int32 height = m_readyHeight;
+        if (width == 0)
         {
-            P_LOG_FATAL << "bad resolution (width and height must not be 0)";
-            return;
+            m_mutexQueue.Unlock();
+            return false;
         }
-
-        P_LOG_INFO << PRODUCT_NAME << ": setting resolution to " << width << "x" << height;
-
-        m_imgWidth  = width%16 == 0 ? width : width + 16 - width%16;
-        m_imgHeight = height;
-
-        const int32 sizeOfBuffer = m_imgWidth * m_imgHeight * 3;
-        m_queue.ResizeBuffers(sizeOfBuffer);
-
-        LockPixelBuffer();
-        m_pixelBuffer.Resize(sizeOfBuffer);
-        UnlockPixelBuffer();
+        std::swap(m_readySlab, m_deliverySlab);
+        m_readyWidth  = 0;
+        m_readyHeight = 0;
+        m_mutexQueue.Unlock();
+
+        // m_deliverySlab belongs to the consumer thread until the next call
+        const int32 sizeOfFrame = width * height * 3;
+        if (image.GetWidth() != width || image.GetHeight() != height)
+            image = PImage(width, height, PImage::E_BGR8U);
+        memcpy(image.GetDataPtr(), m_deliverySlab.m_data, sizeOfFrame);
+        ONBENCH(BenchCountCopy(sizeOfFrame));
+
+        const unsigned char* src = m_deliverySlab.m_data + sizeOfFrame;
+        for (int32 level = 1; level <= m_numPyramidLevels; ++level)
+        {
+            const int32 levelWidth  = width >> level;
+            const int32 levelHeight = height >> level;
+            PImage& levelImage = m_pyramid[level - 1];
+            if (levelImage.GetWidth() != levelWidth || levelImage.GetHeight() != levelHeight)
+                levelImage = PImage(levelWidth, levelHeight, PImage::E_BGR8U);
+            memcpy(levelImage.GetDataPtr(), src, levelWidth * levelHeight * 3);
+            ONBENCH(BenchCountCopy(levelWidth * levelHeight * 3));
+            src += levelWidth * levelHeight * 3;
+        }
+        return true;
     }
 
-    PResult GetFirstFrame(PFrame& frame)
+    // Waits for the next frame, end-of-stream or an error, whichever comes first, for at most timeOutMs (infinite if negative);
+    // at end-of-stream the first sub-item, if any, is played instead. See TryDequeueImage()
+    PResult DequeueImage(PImage& image, int32 timeOutMs)
     {
-        PImage image(m_imgWidth, m_imgHeight, PImage::E_BGR8U);
-        bool isValidImage = false;
+        const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeOutMs, 0));
 
-        for (int i=0; i<50; ++i)
+        std::unique_lock<std::mutex> lock(m_mutexEvents);
+        for (;;)
         {
-            if (!m_queue.TryDequeue(image.GetDataPtr(), 100))
-            {
-                P_LOG_DEBUG << PRODUCT_NAME << ": no image available";
+            // frames produced before this point are already in the ready slab
+            const int64 numFramesProduced = m_numFramesProduced;
+            lock.unlock();
+            if (TryDequeueImage(image))
+                return PResult::C_OK;
+            lock.lock();
+
+            if (m_numFramesProduced != numFramesProduced)
+                continue;
+
+            if (m_libvlc_event_mediaPlayerEncounteredError)
+                return PResult::Error("no image available: error while playing the stream");
 
+            if (m_libvlc_event_mediaPlayerEndReached)
+            {
+                lock.unlock();
                 P_LOG_TRACE << PRODUCT_NAME << ": try to play sub-item...";
-                if (m_libvlc_event_mediaPlayerEndReached && TryToPlaySubItem().Failed())
-                    return PResult::Error("no image available");
+                if (TryToPlaySubItem().Failed())
+                    return PResult::Error("no image available: end of stream reached");
+                lock.lock();
+                continue;
             }
-            else 
+
+            const auto hasEvent = [&]
             {
-                isValidImage = true;
-                break;
+                return m_numFramesProduced != numFramesProduced || m_libvlc_event_mediaPlayerEndReached || m_libvlc_event_mediaPlayerEncounteredError;
+            };
+            if (timeOutMs < 0)
+                m_eventOccurred.wait(lock, hasEvent);
+            else if (!m_eventOccurred.wait_until(lock, deadline, hasEvent))
+            {
+                P_LOG_DEBUG << PRODUCT_NAME << ": no image available";
+                return PResult::Error("no image available");
             }
         }
+    }
+
+    // Forgets everything left by a previous Open()/Close() of this instance
+    void ResetState()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutexEvents);
+            m_libvlc_event_mediaPlayerEndReached       = false;
+            m_libvlc_event_mediaPlayerEncounteredError = false;
+            m_libvlc_event_mediaPlayerPlaying          = false;
+            m_numFramesProduced                        = 0;
+        }
+        m_isFirstFrame = true;
+        m_frameNumber  = 0;
+        m_scheduling   = SStreamSchedulingState();
+        m_latency.Reset();
+    }
 
-        if (isValidImage)
+    // Called by libvlc threads: wakes up a consumer waiting in GetFirstFrame() or Open()
+    void NotifyEvent(bool* flag)
+    {
         {
-            m_isFirstFrame = false;
-            return BuildFrameFromImage(frame, image);
+            std::lock_guard<std::mutex> lock(m_mutexEvents);
+            if (flag != NULL)
+                *flag = true;
+            else
+                m_numFramesProduced++;
         }
+        m_eventOccurred.notify_all();
+    }
 
-        return PResult::Error("no image available");
+    // Waits for the first frame, see DequeueImage()
+    PResult GetFirstFrame(PFrame& frame, int32 timeOutMs)
+    {
+        PImage image;
+        PResult result = DequeueImage(image, timeOutMs);
+        if (result.Failed())
+            return result;
+        return BuildFrameFromImage(frame, image);
     }
 
     PResult BuildFrameFromImage(PFrame& frame, PImage image)
     {
         if (m_isRGBSwapped)
+        {
             image.SwapRGB(image);
+            for (size_t i = 0; i < m_pyramid.size(); ++i)
+                m_pyramid[i].SwapRGB(m_pyramid[i]);
+        }
 
         frame.SetNewImage(image, PGuid::CreateUniqueId(), PRODUCT_GUID);
         frame.SetSourceFrameNumber(m_frameNumber++);
         frame.SetTimestampToCurrentUTC();
         m_isFirstFrame = false;
+        m_latency.OnFrameDelivered();
+        if (m_isScheduled)
+            SStreamScheduler::GetInstance().OnFrameConsumed(&m_scheduling);
+        return PResult::C_OK;
+    }
+
+    PResult CreateMedia()
+    {
+        if (m_uri.IsFile())
+        {
+            PString filename = m_uri.GetPath();
+            if (PFile::CheckExistsAndIsReadable(filename).Failed())
+                return PResult::ErrorFileNotFound(PString("video file not found: \"%1\"").Arg(filename));
+
+            m_libvlc_media = libvlc_media_new_path(g_libvlc_instance, filename.c_str());
+        }
+        else
+        {
+            m_libvlc_media = libvlc_media_new_location(g_libvlc_instance, m_uri.ToString().c_str());
+        }
+
+        if (m_libvlc_media == NULL)
+            return PResult::ErrorNullPointer("m_libvlc_media");
+
+        libvlc_media_add_option(m_libvlc_media, m_protocol.c_str());
+
+        P_LOG_INFO << PRODUCT_NAME << ": Open: network caching set to " << m_networkCachingInMs << " ms";
+        libvlc_media_add_option(m_libvlc_media, PString("network-caching=%1").Arg(m_networkCachingInMs).c_str());
+
+        if (m_latencyProfile != E_LATENCY_DEFAULT)
+        {
+            libvlc_media_add_option(m_libvlc_media, PString("live-caching=%1").Arg(m_networkCachingInMs).c_str());
+            libvlc_media_add_option(m_libvlc_media, "clock-jitter=0");
+            libvlc_media_add_option(m_libvlc_media, "clock-synchro=0");
+            libvlc_media_add_option(m_libvlc_media, "drop-late-frames");
+            libvlc_media_add_option(m_libvlc_media, "skip-frames");
+        }
+
+        if (m_isScheduled && SStreamScheduler::GetInstance().IsDecodeReduced(&m_scheduling))
+        {
+            P_LOG_INFO << PRODUCT_NAME << ": Open: decoder skips non-reference frames (stream throttled by the scheduler)";
+            libvlc_media_add_option(m_libvlc_media, "avcodec-skip-frame=1");
+        }
+
         return PResult::C_OK;
     }
 
+    // Re-creates the media from the current options and restarts the player.
+    // Must be called from the consumer thread (never from a libvlc callback).
+    bool RestartPlayer()
+    {
+        libvlc_media_player_stop(m_libvlc_media_player);
+        libvlc_media_release(m_libvlc_media);
+        m_libvlc_media = NULL;
+        if (CreateMedia().Failed())
+        {
+            P_LOG_ERROR << PRODUCT_NAME << ": failed to re-create media";
+            return false;
+        }
+        libvlc_media_player_set_media(m_libvlc_media_player, m_libvlc_media);
+        if (libvlc_media_player_play(m_libvlc_media_player) != 0)
+        {
+            P_LOG_ERROR << PRODUCT_NAME << ": failed to restart playing";
+            return false;
+        }
+        return true;
+    }
+
+    // Applies the decoder options decided by the scheduler (see SStreamScheduler::UpdateDecodeReduction()).
+    // Must be called from the consumer thread. Local files are never restarted: they would play again from the start.
+    void ApplyDecodeReduction()
+    {
+        if (!m_isScheduled || m_uri.IsFile())
+            return;
+
+        const double now = m_latency.m_timer.ElapsedSec();
+        if (now - m_lastRestartInSec < SCHEDULER_MIN_RESTART_PERIOD_IN_SEC)
+            return;
+        if (!SStreamScheduler::GetInstance().UpdateDecodeReduction(&m_scheduling))
+            return;
+
+        m_lastRestartInSec = now;
+        RestartPlayer();
+    }
+
+    // In adaptive latency mode, restarts the player with a larger network caching when libvlc drops frames for being late;
+    // a network caching given in the URI is left alone. Must be called from the consumer thread (never from a libvlc callback).
+    void RetuneNetworkCaching()
+    {
+        if (m_latencyProfile != E_LATENCY_ADAPTIVE || m_isNetworkCachingExplicit || m_uri.IsFile())
+            return;
+
+        const double now = m_latency.m_timer.ElapsedSec();
+        if (!m_latency.IsStatsDue(now))
+            return;
+        libvlc_media_stats_t stats;
+        if (!libvlc_media_get_stats(m_libvlc_media, &stats))
+            return;
+        const int32 caching = m_latency.OnInputStats(m_networkCachingInMs, stats.i_displayed_pictures, stats.i_lost_pictures);
+        if (caching == 0 || now - m_lastRestartInSec < ADAPTIVE_MIN_RETUNE_PERIOD_IN_SEC)
+            return;
+
+        P_LOG_INFO << PRODUCT_NAME << ": adaptive latency: network caching " << m_networkCachingInMs << " ms -> " << caching << " ms";
+        m_lastRestartInSec   = now;
+        m_networkCachingInMs = caching;
+        RestartPlayer();
+
+        m_latency.Reset();
+        m_latency.m_numRetunes++;
+    }
+
+    // m_mutexEvents must not be locked by the caller
     PResult TryToPlaySubItem()
     {
-        if (m_libvlc_event_mediaPlayerEndReached)
+        bool isEndReached;
+        {
+            std::lock_guard<std::mutex> lock(m_mutexEvents);
+            isEndReached = m_libvlc_event_mediaPlayerEndReached;
+        }
+        if (isEndReached)
         {
             P_LOG_INFO << PRODUCT_NAME << ": check for sub-items...";
 
-            // check if there is a subitem
-            m_libvlc_media_list = libvlc_media_subitems(m_libvlc_media);
-            if (m_libvlc_media_list == NULL)
+            // check if there is a subitem; libvlc returns an empty list rather than NULL when there is none
+            libvlc_media_list_t* mediaList = libvlc_media_subitems(m_libvlc_media);
+            libvlc_media_t*      subItem   = NULL;
+            if (mediaList != NULL)
+            {
+                libvlc_media_list_lock(mediaList);
+                if (libvlc_media_list_count(mediaList) > 0)
+                    subItem = libvlc_media_list_item_at_index(mediaList, 0);
+                libvlc_media_list_unlock(mediaList);
+            }
+            if (subItem == NULL)
             {
                 P_LOG_INFO << PRODUCT_NAME << ": no sub-item found";
+                if (mediaList != NULL)
+                    libvlc_media_list_release(mediaList);
                 return PResult::Error("reach end-of stream");
             }
             else
             {
-                P_LOG_INFO << PRODUCT_NAME << ": found " << libvlc_media_list_count(m_libvlc_media_list) << " sub-items";
-                m_libvlc_media = libvlc_media_list_item_at_index(m_libvlc_media_list, 0);
+                P_LOG_INFO << PRODUCT_NAME << ": found " << libvlc_media_list_count(mediaList) << " sub-items";
+                // the sub-item holds a reference on its own: release the parent media and the previous list
+                if (m_libvlc_media_list != NULL)
+                    libvlc_media_list_release(m_libvlc_media_list);
+                m_libvlc_media_list = mediaList;
+                libvlc_media_release(m_libvlc_media);
+                m_libvlc_media = subItem;
                 P_LOG_INFO << PRODUCT_NAME << ": stop playing...";
                 libvlc_media_player_set_media(m_libvlc_media_player, m_libvlc_media);
                 P_LOG_INFO << PRODUCT_NAME << ": start playing...";
@@ -226,6 +1541,7 @@ public:
                     P_LOG_ERROR << PRODUCT_NAME << ": failed to play sub-item";
                     return PResult::Error("failed to play sub-item");
                 }
+                std::lock_guard<std::mutex> lock(m_mutexEvents);
                 m_libvlc_event_mediaPlayerEndReached = false;
                 return PResult::C_OK;
             }
@@ -246,17 +1562,41 @@ public:
     libvlc_event_manager_t*   m_libvlc_event_manager                    ;
     libvlc_media_list_t*      m_libvlc_media_list                       ;
     PMutex                    m_mutexPixelBuffer                        ;
-    PByteArray                m_pixelBuffer                             ;
-    PConcurrentRawBufferQueue m_queue                                   ;
+    SFrameSlab                m_pixelSlab                               ;//!< frame written by libvlc, from SFrameArena
+    PMutex                    m_mutexQueue                              ;//!< protects m_readySlab and its geometry
+    SFrameSlab                m_readySlab                               ;//!< last frame not delivered yet and its pyramid levels, from SFrameArena
+    int32                     m_readyWidth                              ;//!< geometry of the frame in m_readySlab, 0 if there is none
+    int32                     m_readyHeight                             ;
     int32                     m_imgWidth                                ;
     int32                     m_imgHeight                               ;
     int32                     m_networkCachingInMs                      ;
+    bool                      m_isNetworkCachingExplicit                ;//!< set by "network-caching": never re-tuned
     PString                   m_protocol                                ;
     bool                      m_isRGBSwapped                            ;
-    bool                      m_libvlc_event_mediaPlayerEndReached      ;
-    bool                      m_libvlc_event_mediaPlayerEncounteredError;
+    bool                      m_libvlc_event_mediaPlayerEndReached      ;//!< protected by m_mutexEvents
+    bool                      m_libvlc_event_mediaPlayerEncounteredError;//!< protected by m_mutexEvents
     bool                      m_libvlc_event_mediaPlayerPlaying         ;
     int32                     m_frameNumber                             ;
+    SStreamSchedulingState    m_scheduling                              ;
+    bool                      m_isScheduled                             ;
+    int32                     m_latencyProfile                          ;
+    SLatencyState             m_latency                                 ;
+    double                    m_lastRestartInSec                        ;//!< last time the consumer thread restarted the player
+    std::mutex                m_mutexEvents                             ;
+    std::condition_variable   m_eventOccurred                           ;
+    int64                     m_numFramesProduced                       ;//!< protected by m_mutexEvents
+    int32                     m_numPyramidLevels                        ;//!< number of half-resolution levels delivered with each frame
+    int32                     m_formatWidth                             ;//!< size of the images written by libvlc (see CallbackFormat), 0 until known
+    int32                     m_formatHeight                            ;
+    int32                     m_bufferSize                              ;//!< bytes used in m_pixelSlab: a frame and its pyramid levels, protected by m_mutexPixelBuffer
+    SFrameSlab                m_deliverySlab                            ;//!< frame being delivered and its pyramid levels (consumer thread), from SFrameArena
+    std::vector<PImage>       m_pyramid                                 ;//!< levels of the last delivered frame, reused from frame to frame
+    bool                      m_isLicenseCheckedOut                     ;//!< license checked out by Open(), checked in by ReleaseStream()
+    PString                   m_sharedMemoryName                        ;//!< empty if frames are not exported
+    int32                     m_sharedMemorySlots                       ;
+#if USE_SHARED_MEMORY
+    SSharedFrameRing          m_sharedMemory                            ;//!< accessed by the decoding thread only, once opened
+#endif
 };
 
 
@@ -269,6 +1609,7 @@ void PPlugin_CreateInstance(PResult& result, void** instance, const PProperties&
     }
 
     *instance = new SInputStream();
+    g_numInstances++;
 
     result = PResult::C_OK;
 }
@@ -282,6 +1623,7 @@ void PPlugin_DestroyInstance(papillon::PResult& result, void** instance)
 
         SInputStream* is = static_cast<SInputStream*>(*instance);
         delete is; *instance = NULL;
+        g_numInstances--;
 
         result = PLicensing::GetInstance().CheckInLicense(PRODUCT_NAME).PrependErrorMessage(PRODUCT_LOG);
     }
@@ -311,16 +1653,6 @@ void PPlugin_VideoStream_AcceptURI(PResult& result, const PUri& uri)
 }
 
 
-static void CallbackLoggingVLC(void* /*data*/, int level, const libvlc_log_t *ctx, const char *fmt, va_list args)
-{
-    // note: this function is thread-safe because the Papillon logging system is thread-safe
-    const int MAX_BUFFER_SIZE = 8192;
-    char buffer[MAX_BUFFER_SIZE];
-    vsnprintf(buffer, MAX_BUFFER_SIZE, fmt, args); // clamp buffer larger than MAX_BUFFER_SIZE
-    P_LOG_TRACE << PRODUCT_NAME << ": libVLC log: " << PString(buffer);
-}
-
-
 static void* CallbackLockVideoMemory(void* data, void** p_pixels)
 {
     P_LOG_TRACE << PRODUCT_NAME << ": CallbackLockVideoMemory()";
@@ -359,8 +1691,22 @@ static void CallbackUnlockVideoMemory(void* data, void* id, void* const* p_pixel
     SInputStream* is = reinterpret_cast<SInputStream*>(data);
     if (is != NULL)
     {
-        is->m_queue.Enqueue(is->m_pixelBuffer.AsConstPtr<void>());
-        is->UnlockPixelBuffer();
+        is->m_latency.OnFrameOutput();
+
+        // the scheduler may ask to skip this frame to lower the delivered frame rate under CPU pressure
+        if (!is->m_isScheduled || SStreamScheduler::GetInstance().OnFrameDecoded(&is->m_scheduling, is->m_imgWidth, is->m_imgHeight))
+        {
+            is->m_latency.OnFrameDecoded();
+            is->BuildPyramid();
+            is->PublishToSharedMemory();
+            is->EnqueueFrame();
+            is->UnlockPixelBuffer();
+            is->NotifyEvent(NULL);
+        }
+        else
+        {
+            is->UnlockPixelBuffer();
+        }
     }
 }
 
@@ -383,7 +1729,7 @@ static void CallbackMediaPlayer(const libvlc_event_t* event, void* data)
     case libvlc_MediaPlayerOpening           : P_LOG_DEBUG << PRODUCT_NAME << ": callback media player: MediaPlayerOpening"; break;
     case libvlc_MediaPlayerBuffering         : {
         ONDEBUG(P_LOG_DEBUG << PRODUCT_NAME << ": callback media player: MediaPlayerBuffering");
-        is->m_libvlc_event_mediaPlayerPlaying = true;
+        is->NotifyEvent(&is->m_libvlc_event_mediaPlayerPlaying);
         break;
                                                }
     case libvlc_MediaPlayerPlaying           : P_LOG_DEBUG << PRODUCT_NAME << ": callback media player: MediaPlayerPlaying"; break;
@@ -393,11 +1739,11 @@ static void CallbackMediaPlayer(const libvlc_event_t* event, void* data)
     case libvlc_MediaPlayerBackward          : P_LOG_DEBUG << PRODUCT_NAME << ": callback media player: MediaPlayerBackward"; break;
     case libvlc_MediaPlayerEndReached        : 
         P_LOG_DEBUG << PRODUCT_NAME << ": callback media player: MediaPlayerEndReached";
-        is->m_libvlc_event_mediaPlayerEndReached = true;
+        is->NotifyEvent(&is->m_libvlc_event_mediaPlayerEndReached);
         break;
     case libvlc_MediaPlayerEncounteredError  : 
         P_LOG_ERROR << PRODUCT_NAME << ": callback media player: MediaPlayerEncounteredError";
-        is->m_libvlc_event_mediaPlayerEncounteredError = true;
+        is->NotifyEvent(&is->m_libvlc_event_mediaPlayerEncounteredError);
         break;
     case libvlc_MediaPlayerTimeChanged       : {
         ONDEBUG(libvlc_time_t time = libvlc_media_player_get_time(is->m_libvlc_media_player);
@@ -447,7 +1793,7 @@ static void CallbackMediaPlayer(const libvlc_event_t* event, void* data)
                 is->SetResolution(is->m_imgWidth, is->m_imgHeight);
             }
             P_LOG_DEBUG << PRODUCT_NAME << ": callback media player: MediaPlayerVout";
-            is->m_isOpened = true;
+            is->NotifyEvent(&is->m_isOpened);
             break;
         }
     default                                  : P_LOG_DEBUG << PRODUCT_NAME << ": callback media player: unknown"; break;
@@ -462,6 +1808,12 @@ static unsigned int CallbackFormat(void** data, char* chroma, unsigned int* widt
 
     SInputStream* is = reinterpret_cast<SInputStream*>(*data);
     strcpy(chroma, "RV24");
+    // width and height are in/out: with a resolution given in the URI, libvlc scales the images to it
+    if (!is->m_isAutoResolution)
+    {
+        *width  = is->m_imgWidth;
+        *height = is->m_imgHeight;
+    }
     pitches[0] = pitches[1] = pitches[2] = *width * 3;
     lines[0] = lines[1] = lines[2] = *height;
 
@@ -472,17 +1824,96 @@ static unsigned int CallbackFormat(void** data, char* chroma, unsigned int* widt
         is->m_imgHeight = *height;
     }
 
-    const int32 sizeOfBuffer = (*width) * (*height) * 3;
-    is->m_queue.ResizeBuffers(sizeOfBuffer);
-
-    is->LockPixelBuffer();
-    is->m_pixelBuffer.Resize(sizeOfBuffer);
-    is->UnlockPixelBuffer();
+    if (!is->ResizeBuffers(*width, *height, true))
+    {
+        // the previous buffers are too small for this format: let libvlc fail the video output rather than overflow them
+        P_LOG_ERROR << PRODUCT_NAME << ": no frame buffer for " << *width << "x" << *height << " (frame arena cap reached)";
+        return 0;
+    }
+    is->OpenSharedMemory();
 
     return 1;
 }
 
 
+static void DetachEvents(SInputStream* is)
+{
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerMediaChanged      , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerNothingSpecial    , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerOpening           , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerBuffering         , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerPlaying           , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerPaused            , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerStopped           , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerForward           , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerBackward          , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerEndReached        , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerEncounteredError  , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerTimeChanged       , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerPositionChanged   , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerSeekableChanged   , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerPausableChanged   , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerTitleChanged      , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerSnapshotTaken     , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerLengthChanged     , CallbackMediaPlayer, is);
+    libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerVout              , CallbackMediaPlayer, is);
+}
+
+
+// Releases everything Open() may have created, whatever the point where it stopped
+static void ReleaseStream(SInputStream* is)
+{
+    if (is->m_libvlc_media_player != NULL)
+    {
+        P_LOG_INFO << PRODUCT_NAME << ": Close: unregister callback to retrieve images";
+        libvlc_video_set_callbacks(is->m_libvlc_media_player, NULL, NULL, NULL, is);
+
+        if (is->m_libvlc_event_manager != NULL)
+        {
+            P_LOG_INFO << PRODUCT_NAME << ": Close: detach event manager";
+            DetachEvents(is);
+            is->m_libvlc_event_manager = NULL;
+        }
+
+        P_LOG_INFO << PRODUCT_NAME << ": Close: stop playing...";
+        libvlc_media_player_stop(is->m_libvlc_media_player);
+    }
+
+    if (is->m_isScheduled)
+    {
+        SStreamScheduler::GetInstance().Unregister(&is->m_scheduling);
+        is->m_isScheduled = false;
+    }
+
+    is->CloseSharedMemory();
+    is->ReleaseBuffers();
+
+    if (is->m_libvlc_media_list != NULL)
+    {
+        libvlc_media_list_release(is->m_libvlc_media_list);
+        is->m_libvlc_media_list = NULL;
+    }
+
+    if (is->m_libvlc_media_player != NULL)
+    {
+        libvlc_media_player_release(is->m_libvlc_media_player);
+        is->m_libvlc_media_player = NULL;
+    }
+
+    if (is->m_libvlc_media != NULL)
+    {
+        libvlc_media_release(is->m_libvlc_media);
+        is->m_libvlc_media = NULL;
+    }
+
+    if (is->m_isLicenseCheckedOut)
+    {
+        PLicensing::GetInstance().CheckInLicense(PRODUCT_NAME);
+        is->m_isLicenseCheckedOut = false;
+    }
+}
+
+
 void PPlugin_VideoStream_Open(PResult& result, void* instance, const PUri& uri)
 {
     P_LOG_INFO << PRODUCT_NAME << " " << PVersion(PRODUCT_VERSION) << ": try to open " << uri.ToString().Quote();
@@ -503,6 +1934,7 @@ void PPlugin_VideoStream_Open(PResult& result, void* instance, const PUri& uri)
 
     // here, m_isOpened is false...
     is->m_uri = uri;
+    is->ResetState();
 
     try
     {
@@ -524,45 +1956,76 @@ void PPlugin_VideoStream_Open(PResult& result, void* instance, const PUri& uri)
 
         is->m_isRGBSwapped = is->m_uri.HasQueryItem("rgbSwapped");
 
-        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"uri\"         = " << is->m_uri.ToString();
-        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"resolution\"  = " << is->m_imgWidth << "x" << is->m_imgHeight;
-        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"protocol\"    = " << is->m_protocol;
-        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"swapRedBlue\" = " << is->m_isRGBSwapped;
+        if (!is->m_uri.GetQueryValue("pyramid", is->m_numPyramidLevels))
+            is->m_numPyramidLevels = 0;
+        is->m_numPyramidLevels = std::min(std::max(is->m_numPyramidLevels, 0), MAX_PYRAMID_LEVELS);
+        is->m_pyramid.resize(is->m_numPyramidLevels);
+
+        if (!is->m_uri.GetQueryValue("shm", is->m_sharedMemoryName))
+            is->m_sharedMemoryName = PString();
+        if (!is->m_uri.GetQueryValue("shmSlots", is->m_sharedMemorySlots) || is->m_sharedMemorySlots < 2)
+            is->m_sharedMemorySlots = DEFAULT_SHARED_MEMORY_SLOTS;
+#if USE_SHARED_MEMORY
+        if (!is->m_sharedMemoryName.IsEmpty() && is->m_sharedMemoryName.c_str()[0] != '/')
+            is->m_sharedMemoryName = PString("/") + is->m_sharedMemoryName;
+#else
+        if (!is->m_sharedMemoryName.IsEmpty())
+        {
+            result = PResult::C_ERROR_NOT_SUPPORTED;
+            return;
+        }
+#endif
 
-        libvlc_log_set(g_libvlc_instance, CallbackLoggingVLC, is);
+        PString priority;
+        is->m_scheduling.m_name     = is->m_uri.ToString();
+        is->m_scheduling.m_priority = is->m_uri.GetQueryValue("priority", priority) ? PriorityFromString(priority) : int32(E_PRIORITY_NORMAL);
 
-        if (is->m_uri.IsFile())
+        PString latency;
+        is->m_latencyProfile     = E_LATENCY_DEFAULT;
+        is->m_networkCachingInMs       = DEFAULT_NETWORK_CACHING_IN_MS;
+        is->m_isNetworkCachingExplicit = false;
+        if (is->m_uri.GetQueryValue("latency", latency))
         {
-            PString filename = is->m_uri.GetPath();
-            if (PFile::CheckExistsAndIsReadable(filename).Failed())
-            {
-                result = PResult::ErrorFileNotFound(PString("video file not found: \"%1\"").Arg(filename));
-                return;
-            }
-
-            is->m_libvlc_media = libvlc_media_new_path(g_libvlc_instance, filename.c_str());
+            if (latency == "low")
+                is->m_latencyProfile = E_LATENCY_LOW;
+            else if (latency == "adaptive")
+                is->m_latencyProfile = E_LATENCY_ADAPTIVE;
+            else
+                P_LOG_ERROR << PRODUCT_NAME << ": Open: unknown latency profile " << latency.Quote() << ", use default";
+            if (is->m_latencyProfile != E_LATENCY_DEFAULT)
+                is->m_networkCachingInMs = LOW_LATENCY_NETWORK_CACHING_IN_MS;
         }
-        else
+
+        int32 networkCaching;
+        if (is->m_uri.GetQueryValue("network-caching", networkCaching))
         {
-            is->m_libvlc_media = libvlc_media_new_location(g_libvlc_instance, is->m_uri.ToString().c_str());
+            is->m_networkCachingInMs       = networkCaching;
+            is->m_isNetworkCachingExplicit = true;
         }
 
-        if (is->m_libvlc_media == NULL)
+        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"uri\"         = " << is->m_uri.ToString();
+        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"resolution\"  = " << is->m_imgWidth << "x" << is->m_imgHeight;
+        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"protocol\"    = " << is->m_protocol;
+        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"swapRedBlue\" = " << is->m_isRGBSwapped;
+        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"priority\"    = " << PriorityToString(is->m_scheduling.m_priority);
+        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"latency\"     = " << LatencyProfileToString(is->m_latencyProfile);
+        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"pyramid\"     = " << is->m_numPyramidLevels;
+        P_LOG_INFO << PRODUCT_NAME << ": Open: parameter \"shm\"         = " << is->m_sharedMemoryName;
+
+        result = is->CreateMedia();
+        if (result.Failed())
         {
-            result = PResult::ErrorNullPointer("m_libvlc_media");
+            ReleaseStream(is);
             return;
         }
 
-        libvlc_media_add_option(is->m_libvlc_media, is->m_protocol.c_str());
-
-        int32 networkCaching;
-        if (is->m_uri.GetQueryValue("network-caching", networkCaching))
-            is->m_networkCachingInMs = networkCaching;
-        P_LOG_INFO << PRODUCT_NAME << ": Open: network caching set to " << is->m_networkCachingInMs << " ms";
-        libvlc_media_add_option(is->m_libvlc_media, PString("network-caching=%1").Arg(is->m_networkCachingInMs).c_str());
-
         is->m_libvlc_media_player = libvlc_media_player_new_from_media(is->m_libvlc_media);
-
+        if (is->m_libvlc_media_player == NULL)
+        {
+            ReleaseStream(is);
+            result = PResult::ErrorNullPointer("m_libvlc_media_player");
+            return;
+        }
 
         P_LOG_DEBUG << PRODUCT_NAME << ": Open: register callback to retrieve images";
         libvlc_video_set_callbacks(is->m_libvlc_media_player, CallbackLockVideoMemory, CallbackUnlockVideoMemory, NULL, is);
@@ -595,25 +2058,34 @@ void PPlugin_VideoStream_Open(PResult& result, void* instance, const PUri& uri)
 
         if (PLicensing::GetInstance().CheckOutLicense(PRODUCT_NAME, PRODUCT_VERSION).Failed())
         {
+            ReleaseStream(is);
             result = PResult::ErrorFailedToCheckOutLicense(PRODUCT_NAME, PRODUCT_VERSION);
             return;
         }
+        is->m_isLicenseCheckedOut = true;
 
         P_LOG_INFO << PRODUCT_NAME << ": Open: start playing...";
         if (libvlc_media_player_play(is->m_libvlc_media_player) != 0)
         {
+            ReleaseStream(is);
             result = PResult::Error("failed to open video source");
             return;
         }
 
-        // try to play the video stream; waits at most 10 seconds
-        PTimer timer;
-        while (!is->m_libvlc_event_mediaPlayerPlaying && !is->m_libvlc_event_mediaPlayerEncounteredError && (timer.ElapsedSec() < 10.0))
-            PConcurrentThread::Sleep(1);
+        // try to play the video stream; waits at most OPEN_TIMEOUT_IN_SEC seconds
+        bool isPlaying = false;
+        {
+            std::unique_lock<std::mutex> lock(is->m_mutexEvents);
+            isPlaying = is->m_eventOccurred.wait_for(lock, std::chrono::seconds(OPEN_TIMEOUT_IN_SEC), [is]
+            {
+                return is->m_libvlc_event_mediaPlayerPlaying || is->m_libvlc_event_mediaPlayerEncounteredError;
+            }) && !is->m_libvlc_event_mediaPlayerEncounteredError;
+        }
 
-        if (!is->m_libvlc_event_mediaPlayerPlaying)
+        if (!isPlaying)
         {
-            PPlugin_VideoStream_Close(result, instance);
+            ReleaseStream(is);
+            is->m_isOpened = false;
             P_LOG_ERROR << PRODUCT_NAME << ": Open: unable to play the stream";
             result = PResult::Error("unable to play the stream");
             return;
@@ -621,29 +2093,44 @@ void PPlugin_VideoStream_Open(PResult& result, void* instance, const PUri& uri)
 
         // wait until we get some video - m_isOpened is received on first video frame so no need to wait for is parsed
         // https://forum.videolan.org/viewtopic.php?t=95728
-        while (/*!libvlc_media_is_parsed(m_libvlc_media) || */!is->m_isOpened && !is->m_libvlc_event_mediaPlayerEncounteredError)
-            PConcurrentThread::Sleep(10);
+        // a stream without video (or which ends before) would otherwise block forever
+        bool hasVideo = false;
+        {
+            std::unique_lock<std::mutex> lock(is->m_mutexEvents);
+            hasVideo = is->m_eventOccurred.wait_for(lock, std::chrono::seconds(OPEN_TIMEOUT_IN_SEC), [is]
+            {
+                return is->m_isOpened || is->m_libvlc_event_mediaPlayerEncounteredError || is->m_libvlc_event_mediaPlayerEndReached;
+            }) && is->m_isOpened && !is->m_libvlc_event_mediaPlayerEncounteredError;
+        }
 
-        if (is->m_libvlc_event_mediaPlayerEncounteredError)
+        if (!hasVideo)
         {
-            PPlugin_VideoStream_Close(result, instance);
-            P_LOG_ERROR << PRODUCT_NAME << ": Open: unable to play the stream - unexpected error";
+            ReleaseStream(is);
+            is->m_isOpened = false;
+            P_LOG_ERROR << PRODUCT_NAME << ": Open: unable to play the stream - unexpected error or no video";
             result = PResult::Error("unable to play the stream");
             return;
         }
 
         P_LOG_INFO << PRODUCT_NAME << ": Open: success, " << uri.ToString().Quote() << " opened, ready to get frames...";
 
+        SStreamScheduler::GetInstance().Register(&is->m_scheduling);
+        is->m_isScheduled = true;
+
         is->m_isOpened = true;
         result = PResult::C_OK;
     }
     catch (std::exception&)
     {
+        ReleaseStream(is);
+        is->m_isOpened = false;
         result = PResult::Error("failed to open video stream...");
         return;
     }
     catch (...)
     {
+        ReleaseStream(is);
+        is->m_isOpened = false;
         result = PResult::Error("failed to open video stream: unknown exception");
         return;
     }
@@ -671,48 +2158,7 @@ void PPlugin_VideoStream_Close(PResult& result, void* instance)
 
     try
     {
-        // is->m_libvlc_media is not NULL
-
-        P_LOG_INFO << PRODUCT_NAME << ": Close: unregister callback to retrieve images";
-        libvlc_video_set_callbacks(is->m_libvlc_media_player, NULL, NULL, NULL, is);
-
-        P_LOG_INFO << PRODUCT_NAME << ": Close: detach event manager";
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerMediaChanged      , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerNothingSpecial    , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerOpening           , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerBuffering         , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerPlaying           , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerPaused            , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerStopped           , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerForward           , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerBackward          , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerEndReached        , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerEncounteredError  , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerTimeChanged       , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerPositionChanged   , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerSeekableChanged   , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerPausableChanged   , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerTitleChanged      , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerSnapshotTaken     , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerLengthChanged     , CallbackMediaPlayer, is);
-        libvlc_event_detach(is->m_libvlc_event_manager, libvlc_MediaPlayerVout              , CallbackMediaPlayer, is);
-
-        P_LOG_INFO << PRODUCT_NAME << ": Close: stop playing...";
-        libvlc_media_player_stop(is->m_libvlc_media_player);
-
-        if (is->m_libvlc_media_list != NULL)
-        {
-            libvlc_media_list_release(is->m_libvlc_media_list);
-            is->m_libvlc_media_list = NULL;
-        }
-
-        libvlc_media_player_release(is->m_libvlc_media_player);
-        is->m_libvlc_media_player = NULL;
-
-        libvlc_media_release(is->m_libvlc_media);
-        is->m_libvlc_media = NULL;
-
-        libvlc_log_unset(g_libvlc_instance);
+        ReleaseStream(is);
         P_LOG_INFO << PRODUCT_NAME << ": Close: Ok";
     }
     catch (...)
@@ -778,26 +2224,25 @@ void PPlugin_VideoStream_GetFrame(PResult& result, void* instance, PFrame& frame
 
     try
     {
-        PImage image(is->m_imgWidth, is->m_imgHeight, PImage::E_BGR8U);
-
         if (is->m_isFirstFrame)
         {
-            result = is->GetFirstFrame(frame);
+            result = is->GetFirstFrame(frame, timeOutMs);
             ONDEBUG(std::cerr << "GetFrame first frame\n");
             return;
         }
 
-        if (!is->m_queue.TryDequeue(image.GetDataPtr(), timeOutMs))
+        PImage image;
+        result = is->DequeueImage(image, timeOutMs);
+        if (result.Failed())
         {
-            P_LOG_DEBUG << PRODUCT_NAME << ": no image available";
-            {
-                result = PResult::Error("no image available");
-                ONDEBUG(std::cerr << "GetFrame no image available\n");
-                return;
-            }            
+            ONDEBUG(std::cerr << "GetFrame no image available\n");
+            return;
         }
 
         result = is->BuildFrameFromImage(frame, image);
+
+        is->RetuneNetworkCaching();
+        is->ApplyDecodeReduction();
     }
     catch (...)
     {
@@ -807,9 +2252,107 @@ void PPlugin_VideoStream_GetFrame(PResult& result, void* instance, PFrame& frame
 }
 
 
-void PPlugin_Get(PResult& result, void* /*instance*/, const PString& /*property*/, PObject& /*object*/)
+void PPlugin_Get(PResult& result, void* instance, const PString& property, PObject& object)
 {
-    result = PResult::C_ERROR_NOT_SUPPORTED;
+    // pyramid levels of the last frame returned by GetFrame(), valid until the next call
+    for (int32 level = 1; level <= MAX_PYRAMID_LEVELS; ++level)
+    {
+        if (property != PString("pyramidLevel%1").Arg(level))
+            continue;
+
+        PImage* image = dynamic_cast<PImage*>(&object);
+        if (instance == NULL || image == NULL)
+        {
+            result = PResult::ErrorNullPointer("unexpected NULL instance or image");
+            return;
+        }
+        SInputStream* is = static_cast<SInputStream*>(instance);
+        if (level > is->m_numPyramidLevels)
+        {
+            result = PResult::Error(PString("pyramid level %1 not enabled (see \"pyramid\" option)").Arg(level));
+            return;
+        }
+        *image = is->m_pyramid[level - 1];
+        result = PResult::C_OK;
+        return;
+    }
+
+    PProperties* properties = dynamic_cast<PProperties*>(&object);
+    if (properties == NULL)
+    {
+        result = PResult::C_ERROR_NOT_SUPPORTED;
+        return;
+    }
+
+    if (property == "scheduler")
+    {
+        SStreamScheduler::GetInstance().GetProperties(*properties);
+        result = PResult::C_OK;
+    }
+    else if (property == "frameArena")
+    {
+        // frame buffers of all the streams of the process
+        SFrameArena::GetInstance().GetProperties(*properties);
+        result = PResult::C_OK;
+    }
+    else if (property == "process")
+    {
+        // resources of the whole process, to track leaks when streams are opened and closed constantly
+        const SProcessStats stats = SProcessStats::Get();
+        properties->Set("residentSetSizeInBytes", int64(stats.m_residentSetSizeInBytes));
+        properties->Set("numFileDescriptors"    , int32(stats.m_numFileDescriptors));
+        properties->Set("numThreads"            , int32(stats.m_numThreads));
+        properties->Set("numInstances"          , int32(g_numInstances.load()));
+        result = PResult::C_OK;
+    }
+    else if (property == "sharedMemory")
+    {
+        if (instance == NULL)
+        {
+            result = PResult::ErrorNullPointer("unexpected NULL instance");
+            return;
+        }
+        SInputStream* is = static_cast<SInputStream*>(instance);
+        properties->Set("name", is->m_sharedMemoryName);
+#if USE_SHARED_MEMORY
+        is->LockPixelBuffer();
+        const bool isOpened = is->m_sharedMemory.IsOpened();
+        properties->Set("isOpened"    , isOpened);
+        properties->Set("numSlots"    , isOpened ? int32(is->m_sharedMemory.GetHeader()->m_numSlots) : 0);
+        properties->Set("dataCapacity", isOpened ? int32(is->m_sharedMemory.GetHeader()->m_dataCapacity) : 0);
+        properties->Set("numPublished", isOpened ? int64(is->m_sharedMemory.GetHeader()->m_numPublished.load()) : int64(0));
+        is->UnlockPixelBuffer();
+#else
+        properties->Set("isOpened", false);
+#endif
+        result = PResult::C_OK;
+    }
+    else if (property == "latency")
+    {
+        if (instance == NULL)
+        {
+            result = PResult::ErrorNullPointer("unexpected NULL instance");
+            return;
+        }
+        SInputStream* is = static_cast<SInputStream*>(instance);
+        is->m_latency.GetProperties(is->m_latencyProfile, is->m_networkCachingInMs, *properties);
+        result = PResult::C_OK;
+    }
+    else if (property == "scheduling")
+    {
+        if (instance == NULL)
+        {
+            result = PResult::ErrorNullPointer("unexpected NULL instance");
+            return;
+        }
+        SInputStream* is = static_cast<SInputStream*>(instance);
+        SStreamScheduler::GetInstance().GetStreamProperties(&is->m_scheduling, *properties);
+        result = PResult::C_OK;
+    }
+    else
+    {
+        result = PResult::C_ERROR_NOT_SUPPORTED;
+    }
 }
 
 
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2014 Digital Barriers plc. All rights reserved.
+ * Contact: http://www.digitalbarriers.com/
+ *
+ * This file is part of the Papillon SDK.
+ *
+ * You can't use, modify or distribute any part of this file without
+ * the explicit written agreements of Digital Barriers plc.
+ */
+
+// ****************************************************************************
+// Description:  TCP relay which injects a known jitter in a local stream (used
+//               by loadTestVLC with --jitter-ms, tc netem would need root).
+//
+//               Each client connection is relayed to 127.0.0.1:upstreamPort;
+//               the data sent back to the client is held for a random delay,
+//               uniform in [0, jitterMs], drawn once per burst (data separated
+//               by a gap of at least JITTER_RELAY_BURST_GAP_IN_MS, i.e. one frame
+//               from a server pacing its output), so that consecutive frames
+//               reach the client with independent delays.
+//               Order is preserved: a chunk is never released before the
+//               previous one, so the delay never accumulates.
+//               Because of that ordering the jitter actually injected is lower
+//               than jitterMs / 3 (the mean deviation of independent uniform
+//               delays), so the relay measures it on the release times of the
+//               first chunk of each burst, with the same RFC 3550 estimator
+//               as the plugin: see GetInjectedJitterMs().
+//
+// Linux only (POSIX sockets).
+// ****************************************************************************
+
+#ifndef PAPILLON_PLUGIN_VLC_JITTER_RELAY_H
+#define PAPILLON_PLUGIN_VLC_JITTER_RELAY_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const int JITTER_RELAY_BURST_GAP_IN_MS = 5;
+
+
+class SJitterRelay
+{
+public:
+    SJitterRelay()
+        : m_listenSocket(-1)
+        , m_upstreamPort(0)
+        , m_jitterMs    (0)
+        , m_isRunning   (false)
+        , m_acceptThread()
+        , m_mutex       ()
+        , m_connections ()
+    {
+    }
+
+    ~SJitterRelay()
+    {
+        Stop();
+    }
+
+    // Listens on 127.0.0.1:listenPort; returns false if the port cannot be bound
+    bool Start(int listenPort, int upstreamPort, int jitterMs)
+    {
+        m_upstreamPort = upstreamPort;
+        m_jitterMs     = jitterMs;
+
+        m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listenSocket < 0)
+            return false;
+        const int yes = 1;
+        setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+        sockaddr_in address = MakeAddress(listenPort);
+        if (bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(m_listenSocket, 64) != 0)
+        {
+            close(m_listenSocket);
+            m_listenSocket = -1;
+            return false;
+        }
+
+        m_isRunning    = true;
+        m_acceptThread = std::thread(&SJitterRelay::Accept, this);
+        return true;
+    }
+
+    void Stop()
+    {
+        if (!m_isRunning)
+            return;
+        m_isRunning = false;
+        shutdown(m_listenSocket, SHUT_RDWR);
+        close(m_listenSocket);
+        m_acceptThread.join();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_connections.size(); ++i)
+            m_connections[i]->Stop();
+        m_connections.clear();
+    }
+
+    // Mean over the connections of the jitter injected so far, in ms
+    double GetInjectedJitterMs()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        double sum = 0.0;
+        for (size_t i = 0; i < m_connections.size(); ++i)
+            sum += m_connections[i]->GetInjectedJitterMs();
+        return m_connections.empty() ? 0.0 : sum / m_connections.size();
+    }
+
+private:
+    typedef std::chrono::steady_clock SClock;
+
+    struct SChunk
+    {
+        SClock::time_point m_releaseTime;
+        std::vector<char>  m_data;
+    };
+
+    // one client and its upstream connection
+    class SConnection
+    {
+    public:
+        SConnection(int client, int upstream, int jitterMs)
+            : m_client               (client)
+            , m_upstream             (upstream)
+            , m_jitterMs             (jitterMs)
+            , m_isRunning            (true)
+            , m_mutex                ()
+            , m_chunkQueued          ()
+            , m_chunks               ()
+            , m_threads              ()
+            , m_lastReleaseMs        (-1.0)
+            , m_meanReleaseIntervalMs(0.0)
+            , m_injectedJitterMs     (0.0)
+            , m_numBursts            (0)
+        {
+            m_threads.push_back(std::thread(&SConnection::ForwardRequests, this));
+            m_threads.push_back(std::thread(&SConnection::ReadResponses, this));
+            m_threads.push_back(std::thread(&SConnection::WriteResponses, this));
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_isRunning = false;
+            }
+            m_chunkQueued.notify_all();
+            shutdown(m_client, SHUT_RDWR);
+            shutdown(m_upstream, SHUT_RDWR);
+            for (size_t i = 0; i < m_threads.size(); ++i)
+                m_threads[i].join();
+            close(m_client);
+            close(m_upstream);
+        }
+
+        double GetInjectedJitterMs()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_injectedJitterMs;
+        }
+
+    private:
+        // client -> upstream, not delayed
+        void ForwardRequests()
+        {
+            char buffer[4096];
+            ssize_t size;
+            while ((size = recv(m_client, buffer, sizeof(buffer), 0)) > 0)
+                if (!SendAll(m_upstream, buffer, size_t(size)))
+                    break;
+            shutdown(m_upstream, SHUT_WR);
+        }
+
+        // upstream -> queue, each chunk stamped with its release time
+        void ReadResponses()
+        {
+            std::mt19937 random(std::random_device{}());
+            std::uniform_int_distribution<int> jitter(0, m_jitterMs);
+            SClock::time_point lastReceive;
+            SClock::time_point lastRelease;
+            int                delayMs = 0;
+
+            std::vector<char> buffer(64 * 1024);
+            ssize_t size;
+            while ((size = recv(m_upstream, &buffer[0], buffer.size(), 0)) > 0)
+            {
+                const SClock::time_point now = SClock::now();
+                const bool isNewBurst = now - lastReceive >= std::chrono::milliseconds(JITTER_RELAY_BURST_GAP_IN_MS);
+                if (isNewBurst)
+                    delayMs = jitter(random);
+                lastReceive = now;
+                SChunk chunk;
+                chunk.m_releaseTime = std::max(lastRelease, now + std::chrono::milliseconds(delayMs));
+                chunk.m_data.assign(buffer.begin(), buffer.begin() + size);
+                lastRelease = chunk.m_releaseTime;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    if (isNewBurst)
+                        MeasureRelease(std::chrono::duration<double, std::milli>(chunk.m_releaseTime.time_since_epoch()).count());
+                    m_chunks.push_back(std::move(chunk));
+                }
+                m_chunkQueued.notify_one();
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isRunning = false;
+            m_chunkQueued.notify_all();
+        }
+
+        // queue -> client, once the release time is reached
+        void WriteResponses()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true)
+            {
+                m_chunkQueued.wait(lock, [this] { return !m_chunks.empty() || !m_isRunning; });
+                if (m_chunks.empty())
+                    break;
+                const SClock::time_point releaseTime = m_chunks.front().m_releaseTime;
+                if (SClock::now() < releaseTime)
+                {
+                    // woken up early by a new chunk or by Stop(): re-check
+                    m_chunkQueued.wait_until(lock, releaseTime);
+                    continue;
+                }
+                SChunk chunk = std::move(m_chunks.front());
+                m_chunks.pop_front();
+                lock.unlock();
+                const bool isSent = SendAll(m_client, &chunk.m_data[0], chunk.m_data.size());
+                lock.lock();
+                if (!isSent)
+                    break;
+            }
+            lock.unlock();
+            shutdown(m_client, SHUT_WR);
+        }
+
+        // same estimator as the plugin (SLatencyState); m_mutex must be locked
+        void MeasureRelease(double releaseMs)
+        {
+            if (m_lastReleaseMs >= 0.0)
+            {
+                const double interval = releaseMs - m_lastReleaseMs;
+                if (m_numBursts == 1)
+                    m_meanReleaseIntervalMs = interval;
+                const double deviation = interval > m_meanReleaseIntervalMs ? interval - m_meanReleaseIntervalMs : m_meanReleaseIntervalMs - interval;
+                m_injectedJitterMs      += (deviation - m_injectedJitterMs)      / 16.0;
+                m_meanReleaseIntervalMs += (interval  - m_meanReleaseIntervalMs) / 16.0;
+            }
+            m_lastReleaseMs = releaseMs;
+            m_numBursts++;
+        }
+
+        static bool SendAll(int socket, const char* data, size_t size)
+        {
+            while (size > 0)
+            {
+                const ssize_t sent = send(socket, data, size, MSG_NOSIGNAL);
+                if (sent <= 0)
+                    return false;
+                data += sent;
+                size -= size_t(sent);
+            }
+            return true;
+        }
+
+        int                      m_client;
+        int                      m_upstream;
+        int                      m_jitterMs;
+        bool                     m_isRunning;   //!< protected by m_mutex
+        std::mutex               m_mutex;
+        std::condition_variable  m_chunkQueued;
+        std::deque<SChunk>       m_chunks;
+        std::vector<std::thread> m_threads;
+        double                   m_lastReleaseMs;          //!< release time of the first chunk of the last burst
+        double                   m_meanReleaseIntervalMs;
+        double                   m_injectedJitterMs;
+        int                      m_numBursts;
+    };
+
+    static sockaddr_in MakeAddress(int port)
+    {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family      = AF_INET;
+        address.sin_port        = htons(uint16_t(port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        return address;
+    }
+
+    void Accept()
+    {
+        while (m_isRunning)
+        {
+            const int client = accept(m_listenSocket, NULL, NULL);
+            if (client < 0)
+                continue;
+
+            const int upstream = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in address = MakeAddress(m_upstreamPort);
+            if (upstream < 0 || connect(upstream, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+            {
+                if (upstream >= 0)
+                    close(upstream);
+                close(client);
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_connections.push_back(std::unique_ptr<SConnection>(new SConnection(client, upstream, m_jitterMs)));
+        }
+    }
+
+    int                                         m_listenSocket;
+    int                                         m_upstreamPort;
+    int                                         m_jitterMs;
+    std::atomic<bool>                           m_isRunning;
+    std::thread                                 m_acceptThread;
+    std::mutex                                  m_mutex;
+    std::vector<std::unique_ptr<SConnection> >  m_connections;
+};
+
+#endif // PAPILLON_PLUGIN_VLC_JITTER_RELAY_H
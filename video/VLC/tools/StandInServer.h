@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2014 Digital Barriers plc. All rights reserved.
+ * Contact: http://www.digitalbarriers.com/
+ *
+ * This file is part of the Papillon SDK.
+ *
+ * You can't use, modify or distribute any part of this file without
+ * the explicit written agreements of Digital Barriers plc.
+ */
+
+// ****************************************************************************
+// Description:  stand-in cameras for the tools (loadTestVLC, soakVLC): a clip
+//               generated with ffmpeg, served in loop over RTSP or HTTP by a
+//               local VLC process.
+//
+// Linux only (fork/exec of the server).
+// ****************************************************************************
+
+#ifndef PAPILLON_PLUGIN_VLC_STAND_IN_SERVER_H
+#define PAPILLON_PLUGIN_VLC_STAND_IN_SERVER_H
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+const int STAND_IN_SERVER_CLIP_DURATION_IN_SEC = 30;
+const int STAND_IN_SERVER_STARTUP_IN_SEC       = 2;   // time given to VLC to open its output before the first client
+
+
+class SStandInServer
+{
+public:
+    SStandInServer()
+        : m_pid(-1)
+        , m_uri()
+    {
+    }
+
+    ~SStandInServer()
+    {
+        Stop();
+    }
+
+    // Generates a test pattern clip of the given geometry under /tmp, named after prefix; returns its path, empty on failure
+    static std::string GenerateClip(const std::string& prefix, int width, int height, int fps)
+    {
+        const std::string clip    = "/tmp/" + prefix + "_" + std::to_string(width) + "x" + std::to_string(height) + "_" + std::to_string(fps) + "fps.mp4";
+        const std::string command = "ffmpeg -y -loglevel error -f lavfi -i testsrc=size=" + std::to_string(width) + "x" + std::to_string(height)
+                                  + ":rate=" + std::to_string(fps) + " -t " + std::to_string(STAND_IN_SERVER_CLIP_DURATION_IN_SEC)
+                                  + " -pix_fmt yuv420p -g " + std::to_string(fps) + " " + clip;
+        return std::system(command.c_str()) == 0 ? clip : std::string();
+    }
+
+    // Serves clip in loop with the VLC executable vlc, over "rtsp" or "http" on 127.0.0.1:port; returns false if it cannot be
+    // started. The stream is then at GetUri().
+    bool Start(const std::string& vlc, const std::string& protocol, int port, const std::string& clip)
+    {
+        std::string sout;
+        if (protocol == "rtsp")
+        {
+            m_uri = "rtsp://127.0.0.1:" + std::to_string(port) + "/cam";
+            sout  = "#rtp{sdp=" + m_uri + "}";
+        }
+        else
+        {
+            m_uri = "http://127.0.0.1:" + std::to_string(port) + "/cam";
+            sout  = "#standard{access=http,mux=ts,dst=127.0.0.1:" + std::to_string(port) + "/cam}";
+        }
+
+        m_pid = fork();
+        if (m_pid == 0)
+        {
+            execlp(vlc.c_str(), vlc.c_str(), "-I", "dummy", "--quiet", clip.c_str(), "--loop", "--sout", sout.c_str(), "--sout-keep", (char*)NULL);
+            _exit(127);
+        }
+        if (m_pid < 0)
+            return false;
+        std::this_thread::sleep_for(std::chrono::seconds(STAND_IN_SERVER_STARTUP_IN_SEC));
+        // the exec failed (VLC not installed) if the child is gone already
+        if (waitpid(m_pid, NULL, WNOHANG) == m_pid)
+        {
+            m_pid = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void Stop()
+    {
+        if (m_pid > 0)
+        {
+            kill(m_pid, SIGTERM);
+            waitpid(m_pid, NULL, 0);
+            m_pid = -1;
+        }
+    }
+
+    const std::string& GetUri() const
+    {
+        return m_uri;
+    }
+
+private:
+    pid_t       m_pid;
+    std::string m_uri;
+};
+
+#endif // PAPILLON_PLUGIN_VLC_STAND_IN_SERVER_H
@@ -0,0 +1,469 @@
+/*
+ * Copyright (C) 2014 Digital Barriers plc. All rights reserved.
+ * Contact: http://www.digitalbarriers.com/
+ *
+ * This file is part of the Papillon SDK.
+ *
+ * You can't use, modify or distribute any part of this file without
+ * the explicit written agreements of Digital Barriers plc.
+ */
+
+// ****************************************************************************
+// Description:  benchmark of the frame path of the VLC input video stream
+//               plugin, to separate the cost of the plugin from the cost of
+//               libvlc.
+//
+//               --mode stub (default): no libvlc at all; one producer thread
+//               per stream calls CallbackFormat, CallbackLockVideoMemory and
+//               CallbackUnlockVideoMemory exactly like the libvlc decoding
+//               thread does, one consumer thread per stream calls
+//               PPlugin_VideoStream_GetFrame.
+//
+//               --mode e2e: generates a local clip with ffmpeg (or uses
+//               --file), then opens it through the plugin entry points and
+//               reads it to the end, "--repeat" times per stream; reports
+//               open time and time-to-first-frame as well.
+//
+//               Both modes report ns per frame, heap allocations per frame,
+//               slabs mapped by the frame arena per frame and copies per
+//               frame (see ONBENCH in the plugin), as "bench: key=value" lines
+//               easy to compare between two builds. The plugin keeps only the
+//               newest frame, so a slow consumer drops some: frames produced
+//               (handed over by the decoding thread), delivered (returned by
+//               GetFrame) and dropped are reported; the per-frame metrics are
+//               divided by the produced frames, except getFrameNs and
+//               copiesPerDeliveredFrame.
+//
+//               allocationsPerFrame counts, with glibc, every call to malloc,
+//               calloc, realloc, memalign, aligned_alloc and posix_memalign in
+//               the whole process: the plugin, Papillon and, in e2e mode,
+//               libvlc and its decoders (operator new goes through malloc).
+//               Elsewhere only operator new of this executable is counted.
+//               Neither counts mmap: the frame arena maps its slabs directly
+//               and they are counted apart in arenaMapsPerFrame.
+//
+// Usage:        benchmarkVLC [--mode stub|e2e] [--width W] [--height H] [--fps F]
+//                            [--streams N] [--frames N] [--pyramid N]
+//                            [--repeat N] [--file PATH] [--seconds S]
+//               --fps 0 (default in stub mode) runs the producers as fast as possible
+// ****************************************************************************
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+static std::atomic<int64_t> g_benchNumCopies(0);
+static std::atomic<int64_t> g_benchNumBytesCopied(0);
+static std::atomic<int64_t> g_benchNumAllocations(0);
+static std::atomic<int64_t> g_benchNumArenaMaps(0);
+
+static void BenchCountCopy(int64_t numBytes)
+{
+    g_benchNumCopies++;
+    g_benchNumBytesCopied += numBytes;
+}
+
+static void BenchCountMapping()
+{
+    g_benchNumArenaMaps++;
+}
+
+// the plugin is compiled in this executable so that its callbacks can be called directly
+#define ONBENCH(x) x
+#include "../pluginInputVideoStreamVLC.cpp"
+
+
+#if defined(__GLIBC__)
+// the allocator of the whole process is interposed: the shared libraries (libvlc, Papillon, libstdc++) call these too
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void  __libc_free(void* p);
+
+void* malloc(size_t size) noexcept
+{
+    g_benchNumAllocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    g_benchNumAllocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) noexcept
+{
+    g_benchNumAllocations++;
+    return __libc_realloc(p, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept
+{
+    g_benchNumAllocations++;
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    g_benchNumAllocations++;
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) noexcept
+{
+    g_benchNumAllocations++;
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    *p = __libc_memalign(alignment, size);
+    return *p != NULL || size == 0 ? 0 : ENOMEM;
+}
+
+void free(void* p) noexcept
+{
+    __libc_free(p);
+}
+}
+#else
+void* operator new(std::size_t size)
+{
+    g_benchNumAllocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+#endif
+
+
+typedef std::chrono::steady_clock SClock;
+
+static int64_t ElapsedNs(const SClock::time_point& start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(SClock::now() - start).count();
+}
+
+
+struct SBenchOptions
+{
+    SBenchOptions()
+        : m_mode      ("stub")
+        , m_width     (1920)
+        , m_height    (1080)
+        , m_fps       (0)
+        , m_numStreams(1)
+        , m_numFrames (1000)
+        , m_pyramid   (0)
+        , m_repeat    (1)
+        , m_file      ()
+        , m_seconds   (2)
+    {
+    }
+
+    std::string m_mode;
+    int32       m_width;
+    int32       m_height;
+    int32       m_fps;
+    int32       m_numStreams;
+    int32       m_numFrames;
+    int32       m_pyramid;
+    int32       m_repeat;
+    std::string m_file;
+    int32       m_seconds;
+};
+
+
+// Measurements of all the streams, merged
+struct SBenchResults
+{
+    SBenchResults()
+        : m_numFrames   (0)
+        , m_numProduced (0)
+        , m_producerNs  (0)
+        , m_consumerNs  ()
+        , m_openNs      ()
+        , m_firstFrameNs()
+    {
+    }
+
+    void Merge(const SBenchResults& other)
+    {
+        m_numFrames   += other.m_numFrames;
+        m_numProduced += other.m_numProduced;
+        m_producerNs  += other.m_producerNs;
+        m_consumerNs.insert(m_consumerNs.end(), other.m_consumerNs.begin(), other.m_consumerNs.end());
+        m_openNs.insert(m_openNs.end(), other.m_openNs.begin(), other.m_openNs.end());
+        m_firstFrameNs.insert(m_firstFrameNs.end(), other.m_firstFrameNs.begin(), other.m_firstFrameNs.end());
+    }
+
+    int64_t              m_numFrames;    //!< frames delivered by GetFrame
+    int64_t              m_numProduced;  //!< frames handed over to the consumer by the decoding thread
+    int64_t              m_producerNs;   //!< time spent in lock+unlock callbacks (stub mode)
+    std::vector<int64_t> m_consumerNs;   //!< time spent in each successful GetFrame
+    std::vector<int64_t> m_openNs;       //!< e2e mode
+    std::vector<int64_t> m_firstFrameNs; //!< e2e mode: from the start of Open to the first frame
+};
+
+
+static void PrintDistribution(const char* name, std::vector<int64_t> values)
+{
+    if (values.empty())
+        return;
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < values.size(); ++i)
+        sum += double(values[i]);
+    std::cout << "bench: " << name
+              << " mean=" << int64_t(sum / values.size())
+              << " p50="  << values[values.size() / 2]
+              << " p99="  << values[std::min(values.size() - 1, values.size() * 99 / 100)]
+              << " max="  << values.back() << std::endl;
+}
+
+
+static void RunStubStream(const SBenchOptions& options, int32 index, SBenchResults& results)
+{
+    SInputStream* is = new SInputStream();
+    is->m_isOpened              = true;
+    is->m_isAutoResolution      = true;
+    is->m_needsResolutionUpdate = false;
+    is->m_numPyramidLevels      = options.m_pyramid;
+    is->m_pyramid.resize(options.m_pyramid);
+    is->m_scheduling.m_name     = PString("stub-%1").Arg(index);
+    is->m_scheduling.m_priority = E_PRIORITY_HIGH; // go through the scheduler but never get throttled by the benchmark's own load
+    SStreamScheduler::GetInstance().Register(&is->m_scheduling);
+    is->m_isScheduled           = true;
+
+    void*        data = is;
+    char         chroma[5];
+    unsigned int width = options.m_width, height = options.m_height, pitches[3], lines[3];
+    CallbackFormat(&data, chroma, &width, &height, pitches, lines);
+
+    results.m_consumerNs.reserve(options.m_numFrames);
+    std::atomic<bool> isProducerDone(false);
+
+    std::thread producer([&]
+    {
+        const SClock::time_point start = SClock::now();
+        for (int32 n = 0; n < options.m_numFrames; ++n)
+        {
+            if (options.m_fps > 0)
+                std::this_thread::sleep_until(start + std::chrono::microseconds(int64_t(n) * 1000000 / options.m_fps));
+
+            const SClock::time_point t0 = SClock::now();
+            void* pixels = NULL;
+            CallbackLockVideoMemory(is, &pixels);
+            static_cast<unsigned char*>(pixels)[0] = static_cast<unsigned char>(n); // the decoder would write here
+            CallbackUnlockVideoMemory(is, NULL, &pixels);
+            results.m_producerNs += ElapsedNs(t0);
+            results.m_numProduced++;
+        }
+        isProducerDone = true;
+    });
+
+    PFrame  frame;
+    PResult result;
+    for (;;)
+    {
+        const SClock::time_point t0 = SClock::now();
+        PPlugin_VideoStream_GetFrame(result, is, frame, 200);
+        const int64_t ns = ElapsedNs(t0);
+        if (!result.Failed())
+        {
+            results.m_numFrames++;
+            results.m_consumerNs.push_back(ns);
+        }
+        else if (isProducerDone)
+        {
+            break;
+        }
+    }
+
+    producer.join();
+    SStreamScheduler::GetInstance().Unregister(&is->m_scheduling);
+    is->m_isScheduled = false;
+    delete is;
+}
+
+
+static void RunEndToEndStream(const SBenchOptions& options, const PString& uri, SBenchResults& results)
+{
+    for (int32 r = 0; r < options.m_repeat; ++r)
+    {
+        PResult result;
+        void*   instance = NULL;
+        PPlugin_CreateInstance(result, &instance, PProperties());
+        if (result.Failed())
+        {
+            P_LOG_ERROR << "bench: failed to create instance: " << result;
+            return;
+        }
+
+        const SClock::time_point start = SClock::now();
+        PPlugin_VideoStream_Open(result, instance, PUri(uri));
+        if (result.Failed())
+        {
+            P_LOG_ERROR << "bench: failed to open " << uri << ": " << result;
+            PPlugin_DestroyInstance(result, &instance);
+            continue;
+        }
+        results.m_openNs.push_back(ElapsedNs(start));
+
+        PFrame frame;
+        for (int32 n = 0; options.m_numFrames <= 0 || n < options.m_numFrames; ++n)
+        {
+            const SClock::time_point t0 = SClock::now();
+            PPlugin_VideoStream_GetFrame(result, instance, frame, 2000);
+            const int64_t ns = ElapsedNs(t0);
+            if (result.Failed())
+                break;
+            if (n == 0)
+                results.m_firstFrameNs.push_back(ElapsedNs(start));
+            results.m_numFrames++;
+            results.m_consumerNs.push_back(ns);
+        }
+        {
+            SInputStream* is = static_cast<SInputStream*>(instance);
+            std::lock_guard<std::mutex> lock(is->m_mutexEvents);
+            results.m_numProduced += is->m_numFramesProduced;
+        }
+
+        PPlugin_VideoStream_Close(result, instance);
+        PPlugin_DestroyInstance(result, &instance);
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    SBenchOptions options;
+    bool hasFrames = false;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string arg   = argv[i];
+        const char*       value = argv[i + 1];
+        if      (arg == "--mode")    options.m_mode       = value;
+        else if (arg == "--width")   options.m_width      = atoi(value);
+        else if (arg == "--height")  options.m_height     = atoi(value);
+        else if (arg == "--fps")     options.m_fps        = atoi(value);
+        else if (arg == "--streams") options.m_numStreams = atoi(value);
+        else if (arg == "--frames")  { options.m_numFrames = atoi(value); hasFrames = true; }
+        else if (arg == "--pyramid") options.m_pyramid    = std::min(std::max(atoi(value), 0), MAX_PYRAMID_LEVELS);
+        else if (arg == "--repeat")  options.m_repeat     = atoi(value);
+        else if (arg == "--file")    options.m_file       = value;
+        else if (arg == "--seconds") options.m_seconds    = atoi(value);
+        else
+        {
+            std::cerr << "unknown option " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    PapillonSDK::Initialise().OrDie();
+
+    PString uri;
+    if (options.m_mode == "e2e")
+    {
+        if (!hasFrames)
+            options.m_numFrames = 0; // read the whole clip
+        if (options.m_fps == 0)
+            options.m_fps = 25;
+        if (options.m_file.empty())
+        {
+            options.m_file = PString("/tmp/benchmarkVLC_%1x%2_%3fps_%4s.mp4").Arg(options.m_width).Arg(options.m_height).Arg(options.m_fps).Arg(options.m_seconds).c_str();
+            const PString command = PString("ffmpeg -y -loglevel error -f lavfi -i testsrc=size=%1x%2:rate=%3 -t %4 -pix_fmt yuv420p %5")
+                .Arg(options.m_width).Arg(options.m_height).Arg(options.m_fps).Arg(options.m_seconds).Arg(options.m_file.c_str());
+            if (std::system(command.c_str()) != 0)
+            {
+                std::cerr << "bench: failed to generate " << options.m_file << " (is ffmpeg installed?)" << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        uri = PString("file:%1%2").Arg(options.m_file.c_str()).Arg(options.m_pyramid > 0 ? PString("?pyramid=%1").Arg(options.m_pyramid) : PString());
+
+        PResult result;
+        PPlugin_OnLoad(result);
+        if (result.Failed())
+        {
+            P_LOG_ERROR << "bench: " << result;
+            return EXIT_FAILURE;
+        }
+    }
+    else if (options.m_mode != "stub")
+    {
+        std::cerr << "unknown mode " << options.m_mode << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<SBenchResults> streamResults(options.m_numStreams);
+    std::vector<std::thread>   threads;
+
+    g_benchNumAllocations = 0;
+    g_benchNumArenaMaps   = 0;
+    g_benchNumCopies      = 0;
+    g_benchNumBytesCopied = 0;
+    const SClock::time_point start = SClock::now();
+
+    for (int32 i = 0; i < options.m_numStreams; ++i)
+    {
+        SBenchResults* results = &streamResults[i];
+        if (options.m_mode == "stub")
+            threads.push_back(std::thread([&options, i, results] { RunStubStream(options, i, *results); }));
+        else
+            threads.push_back(std::thread([&options, &uri, results] { RunEndToEndStream(options, uri, *results); }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    const double  elapsedSec     = ElapsedNs(start) * 1e-9;
+    const int64_t numAllocations = g_benchNumAllocations;
+    const int64_t numArenaMaps   = g_benchNumArenaMaps;
+    const int64_t numCopies      = g_benchNumCopies;
+    const int64_t numBytesCopied = g_benchNumBytesCopied;
+
+    SBenchResults total;
+    for (size_t i = 0; i < streamResults.size(); ++i)
+        total.Merge(streamResults[i]);
+    const double numDelivered = double(std::max<int64_t>(total.m_numFrames, 1));
+    const double numProduced  = double(std::max<int64_t>(total.m_numProduced, 1));
+
+    std::cout << "bench: mode=" << options.m_mode << " streams=" << options.m_numStreams
+              << " resolution=" << options.m_width << "x" << options.m_height << " fps=" << options.m_fps
+              << " pyramid=" << options.m_pyramid << std::endl;
+    std::cout << "bench: producedFrames=" << total.m_numProduced << " deliveredFrames=" << total.m_numFrames
+              << " droppedFrames=" << std::max<int64_t>(total.m_numProduced - total.m_numFrames, 0)
+              << " seconds=" << elapsedSec << " deliveredFps=" << total.m_numFrames / elapsedSec << std::endl;
+    if (options.m_mode == "stub")
+        std::cout << "bench: producerNsPerFrame=" << int64_t(total.m_producerNs / numProduced) << std::endl;
+    PrintDistribution("getFrameNs", total.m_consumerNs);
+    PrintDistribution("openNs", total.m_openNs);
+    PrintDistribution("timeToFirstFrameNs", total.m_firstFrameNs);
+    std::cout << "bench: allocationsPerFrame=" << numAllocations / numProduced
+              << " arenaMapsPerFrame=" << numArenaMaps / numProduced
+              << " copiesPerFrame=" << numCopies / numProduced
+              << " bytesCopiedPerFrame=" << int64_t(numBytesCopied / numProduced)
+              << " copiesPerDeliveredFrame=" << numCopies / numDelivered << std::endl;
+
+    if (options.m_mode == "e2e")
+    {
+        PResult result;
+        PPlugin_OnUnload(result);
+    }
+    return EXIT_SUCCESS;
+}
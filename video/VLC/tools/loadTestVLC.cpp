@@ -0,0 +1,442 @@
+/*
+ * Copyright (C) 2014 Digital Barriers plc. All rights reserved.
+ * Contact: http://www.digitalbarriers.com/
+ *
+ * This file is part of the Papillon SDK.
+ *
+ * You can't use, modify or distribute any part of this file without
+ * the explicit written agreements of Digital Barriers plc.
+ */
+
+// ****************************************************************************
+// Description:  multi-camera load test of the VLC input video stream plugin,
+//               to size the hardware: how many cameras can one host take?
+//
+//               - generates a clip with ffmpeg at the chosen resolution/fps
+//               - serves it in loop over RTSP or HTTP from a local VLC
+//                 process (stand-in for the cameras)
+//               - opens N streams through PInputVideoStream::Open, read by C
+//                 consumer threads, and sweeps N upward
+//               - at each point reports delivered fps, drop rate, latency
+//                 percentiles (glass-to-frame as estimated by the plugin, see
+//                 "latency" property, sampled every 100 ms per stream), CPU
+//                 per stream and RSS; consumers poll their streams without
+//                 blocking and sleep 1 ms when none had a frame
+//               - stops at the saturation point: the first N where the drop
+//                 rate exceeds --max-drop, the process uses all the cores or
+//                 a stream fails to open, and prints the reason; fails if not
+//                 even one stream can be opened
+//               - with --jitter-ms J, the stream goes through a relay which
+//                 delays each frame by 0..J ms (see JitterRelay.h); the
+//                 injected jitter is reported next to the output jitter,
+//                 network caching and late frames reported by the plugin, and
+//                 with --latency adaptive, once re-tuned, the fraction of the
+//                 frames libvlc dropped for being late must not exceed
+//                 --max-late-fraction; the tool fails otherwise
+//
+// Usage:        loadTestVLC [--server rtsp|http|none] [--uri URI] [--vlc PATH] [--port P]
+//                           [--width W] [--height H] [--fps F] [--consumers C]
+//                           [--start N] [--step N] [--max N]
+//                           [--warmup S] [--duration S] [--max-drop R]
+//                           [--latency low|adaptive] [--jitter-ms J] [--max-late-fraction R]
+//               --server none reads --uri instead of starting a local server
+//               --jitter-ms serves over HTTP (RTP/RTSP cannot be relayed over TCP)
+//
+// Linux only (fork/exec of the server, /proc for the process statistics).
+// ****************************************************************************
+
+#include <PapillonCore.h>
+#include "../ProcessStats.h"
+#include "JitterRelay.h"
+#include "StandInServer.h"
+// STL
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+// POSIX
+#include <sys/resource.h>
+
+using namespace papillon;
+
+typedef std::chrono::steady_clock SClock;
+
+const int LOAD_TEST_IDLE_SLEEP_IN_MS            = 1;    // consumer pause when none of its streams had a frame
+const int LOAD_TEST_LATENCY_SAMPLE_PERIOD_IN_MS = 100;  // latency is sampled per stream at this period, not on every frame
+
+
+struct SLoadTestOptions
+{
+    SLoadTestOptions()
+        : m_server          ("rtsp")
+        , m_uri             ()
+        , m_vlc             ("cvlc")
+        , m_port            (8554)
+        , m_width           (1280)
+        , m_height          (720)
+        , m_fps             (25)
+        , m_numConsumers    (4)
+        , m_start           (1)
+        , m_step            (2)
+        , m_max             (256)
+        , m_warmUpSec       (3)
+        , m_durationSec     (10)
+        , m_maxDropRate     (0.05)
+        , m_latency         ()
+        , m_jitterMs        (0)
+        , m_maxLateFraction (0.01)
+    {
+    }
+
+    std::string m_server;
+    std::string m_uri;
+    std::string m_vlc;
+    int32       m_port;
+    int32       m_width;
+    int32       m_height;
+    int32       m_fps;
+    int32       m_numConsumers;
+    int32       m_start;
+    int32       m_step;
+    int32       m_max;
+    int32       m_warmUpSec;
+    int32       m_durationSec;
+    double      m_maxDropRate;
+    std::string m_latency;         //!< latency profile of the streams (plugin option "latency")
+    int32       m_jitterMs;        //!< maximum delay injected by the relay, 0 for none
+    double      m_maxLateFraction; //!< tolerated fraction of late frames once the adaptive latency has re-tuned
+};
+
+
+struct SStream
+{
+    SStream()
+        : m_ivs              ()
+        , m_numFrames        (0)
+        , m_lastLatencySample()
+    {
+    }
+
+    PInputVideoStream  m_ivs;
+    std::atomic<int64> m_numFrames;
+    SClock::time_point m_lastLatencySample;  //!< only used by the consumer thread of the stream
+};
+
+
+static double GetProcessCpuSec()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+
+static double Percentile(std::vector<double>& values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, size_t(values.size() * p))];
+}
+
+
+// Reports the latency of the streams under the jitter injected by the relay; returns false if, in adaptive latency mode, the
+// re-tuned network caching still lets libvlc drop late frames
+static bool CheckLatency(const SLoadTestOptions& options, double injectedJitterMs, const std::vector<std::unique_ptr<SStream> >& streams)
+{
+    double outputJitterMs   = 0.0;
+    double networkCachingMs = 0.0;
+    double lateFraction     = 0.0;
+    double glassToFrameMs   = 0.0;
+    int32  numRetunes       = 0;
+    int32  numReported      = 0;
+    for (size_t s = 0; s < streams.size(); ++s)
+    {
+        PProperties latency;
+        double      streamOutputJitterMs = 0.0;
+        int32       streamCachingMs      = 0;
+        double      streamLateFraction   = 0.0;
+        double      streamGlassToFrameMs = 0.0;
+        int32       streamRetunes        = 0;
+        if (streams[s]->m_ivs.Get("latency", latency).Failed()
+            || latency.Get("outputJitterMs", streamOutputJitterMs).Failed()
+            || latency.Get("networkCachingMs", streamCachingMs).Failed()
+            || latency.Get("lateFraction", streamLateFraction).Failed()
+            || latency.Get("glassToFrameEstimateMs", streamGlassToFrameMs).Failed()
+            || latency.Get("numRetunes", streamRetunes).Failed())
+            continue;
+        outputJitterMs   += streamOutputJitterMs;
+        networkCachingMs += streamCachingMs;
+        lateFraction     += streamLateFraction;
+        glassToFrameMs   += streamGlassToFrameMs;
+        numRetunes       += streamRetunes;
+        numReported++;
+    }
+    if (numReported == 0)
+    {
+        std::cout << "load: latency check: FAILED, no latency reported" << std::endl;
+        return false;
+    }
+    outputJitterMs   /= numReported;
+    networkCachingMs /= numReported;
+    lateFraction     /= numReported;
+    glassToFrameMs   /= numReported;
+
+    // the output jitter is what the network cache left, so it is reported but not compared with the injected one
+    const bool isOk = options.m_latency != "adaptive" || numRetunes == 0 || lateFraction <= options.m_maxLateFraction;
+    std::cout << "load: latency check: injected jitter " << injectedJitterMs << " ms (delays 0.." << options.m_jitterMs << " ms), output jitter "
+              << outputJitterMs << " ms, networkCaching " << networkCachingMs << " ms (" << numRetunes << " re-tunes), late frames "
+              << 100.0 * lateFraction << "%, glassToFrame (estimate) " << glassToFrameMs << " ms: " << (isOk ? "OK" : "FAILED") << std::endl;
+    return isOk;
+}
+
+
+int main(int argc, char** argv)
+{
+    SLoadTestOptions options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string arg   = argv[i];
+        const char*       value = argv[i + 1];
+        if      (arg == "--server")            options.m_server          = value;
+        else if (arg == "--uri")               options.m_uri             = value;
+        else if (arg == "--vlc")               options.m_vlc             = value;
+        else if (arg == "--port")              options.m_port            = atoi(value);
+        else if (arg == "--width")             options.m_width           = atoi(value);
+        else if (arg == "--height")            options.m_height          = atoi(value);
+        else if (arg == "--fps")               options.m_fps             = atoi(value);
+        else if (arg == "--consumers")         options.m_numConsumers    = std::max(1, atoi(value));
+        else if (arg == "--start")             options.m_start           = std::max(1, atoi(value));
+        else if (arg == "--step")              options.m_step            = std::max(1, atoi(value));
+        else if (arg == "--max")               options.m_max             = atoi(value);
+        else if (arg == "--warmup")            options.m_warmUpSec       = atoi(value);
+        else if (arg == "--duration")          options.m_durationSec     = std::max(1, atoi(value));
+        else if (arg == "--max-drop")          options.m_maxDropRate     = atof(value);
+        else if (arg == "--latency")           options.m_latency         = value;
+        else if (arg == "--jitter-ms")         options.m_jitterMs        = std::max(0, atoi(value));
+        else if (arg == "--max-late-fraction") options.m_maxLateFraction = atof(value);
+        else
+        {
+            std::cerr << "unknown option " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    PapillonSDK::Initialise().OrDie();
+
+    if (options.m_jitterMs > 0 && options.m_server == "rtsp")
+    {
+        std::cout << "load: --jitter-ms: serving over HTTP" << std::endl;
+        options.m_server = "http";
+    }
+
+    // stand-in cameras
+    SStandInServer server;
+    std::string    uri = options.m_uri;
+    if (options.m_server != "none")
+    {
+        const std::string clip = SStandInServer::GenerateClip("loadTestVLC", options.m_width, options.m_height, options.m_fps);
+        if (clip.empty())
+        {
+            std::cerr << "load: failed to generate the clip (is ffmpeg installed?)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!server.Start(options.m_vlc, options.m_server, options.m_port, clip))
+        {
+            std::cerr << "load: failed to start " << options.m_vlc << std::endl;
+            return EXIT_FAILURE;
+        }
+        uri = server.GetUri();
+    }
+    if (uri.empty())
+    {
+        std::cerr << "load: --uri is required with --server none" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the relay listens next to the server and injects the jitter
+    SJitterRelay relay;
+    if (options.m_jitterMs > 0)
+    {
+        if (options.m_server == "none")
+        {
+            std::cerr << "load: --jitter-ms needs the local server" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!relay.Start(options.m_port + 1, options.m_port, options.m_jitterMs))
+        {
+            std::cerr << "load: failed to start the jitter relay on port " << options.m_port + 1 << std::endl;
+            return EXIT_FAILURE;
+        }
+        uri = "http://127.0.0.1:" + std::to_string(options.m_port + 1) + "/cam";
+    }
+    if (!options.m_latency.empty())
+        uri += (uri.find('?') == std::string::npos ? "?latency=" : "&latency=") + options.m_latency;
+
+    const unsigned int numCores = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "load: uri=" << uri << " resolution=" << options.m_width << "x" << options.m_height << " fps=" << options.m_fps
+              << " consumers=" << options.m_numConsumers << " cores=" << numCores << std::endl;
+    std::cout << "load: streams deliveredFps dropRate latencyP50Ms latencyP95Ms latencyP99Ms cpuPerStream% rssMB" << std::endl;
+
+    std::vector<std::unique_ptr<SStream> > streams;
+    int32       saturation        = 0;
+    bool        isSaturated       = false;
+    int32       saturatedAt       = 0;  // number of streams at which the saturation was detected
+    std::string saturationReason;
+    bool        hasLatencyFailure = false;
+
+    for (int32 n = options.m_start; n <= options.m_max && !isSaturated; n += options.m_step)
+    {
+        // streams are added to the ones already opened; a stream which cannot be opened is a saturation point as well (server,
+        // network or decoder resources exhausted)
+        while (int32(streams.size()) < n && !isSaturated)
+        {
+            std::unique_ptr<SStream> stream(new SStream());
+            const PResult result = PInputVideoStream::Open(PString(uri.c_str()), stream->m_ivs);
+            if (result.Failed())
+            {
+                P_LOG_ERROR << "load: failed to open stream #" << streams.size() << ": " << result;
+                isSaturated      = true;
+                saturatedAt      = int32(streams.size()) + 1;
+                saturationReason = "stream #" + std::to_string(streams.size()) + " failed to open";
+            }
+            else
+            {
+                streams.push_back(std::move(stream));
+            }
+        }
+        if (isSaturated)
+            break;
+
+        std::atomic<bool>   isRunning(true);
+        std::mutex          mutexLatencies;
+        std::vector<double> latencies;
+        std::vector<std::thread> consumers;
+        for (int32 c = 0; c < options.m_numConsumers; ++c)
+        {
+            consumers.push_back(std::thread([&, c]
+            {
+                PFrame frame;
+                while (isRunning)
+                {
+                    // non-blocking poll: waiting on one stream would let the frames of the others be dropped meanwhile
+                    bool hasFrame = false;
+                    for (size_t s = c; s < streams.size(); s += options.m_numConsumers)
+                    {
+                        if (streams[s]->m_ivs.GetFrame(frame, 0).Failed())
+                            continue;
+                        streams[s]->m_numFrames++;
+                        hasFrame = true;
+
+                        // sampled, so that reading the properties does not weigh on the CPU per stream being measured
+                        const SClock::time_point now = SClock::now();
+                        if (now - streams[s]->m_lastLatencySample < std::chrono::milliseconds(LOAD_TEST_LATENCY_SAMPLE_PERIOD_IN_MS))
+                            continue;
+                        streams[s]->m_lastLatencySample = now;
+
+                        // glass-to-frame of this frame: network caching + its own decode-to-delivery time
+                        PProperties latency;
+                        int32       networkCachingMs   = 0;
+                        double      decodeToDeliveryMs = 0.0;
+                        if (streams[s]->m_ivs.Get("latency", latency).Ok()
+                            && latency.Get("networkCachingMs", networkCachingMs).Ok()
+                            && latency.Get("lastDecodeToDeliveryMs", decodeToDeliveryMs).Ok())
+                        {
+                            std::lock_guard<std::mutex> lock(mutexLatencies);
+                            latencies.push_back(networkCachingMs + decodeToDeliveryMs);
+                        }
+                    }
+                    if (!hasFrame)
+                        std::this_thread::sleep_for(std::chrono::milliseconds(LOAD_TEST_IDLE_SLEEP_IN_MS));
+                }
+            }));
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds(options.m_warmUpSec));
+
+        // measurement window
+        int64 framesAtStart = 0;
+        for (size_t s = 0; s < streams.size(); ++s)
+            framesAtStart += streams[s]->m_numFrames;
+        {
+            std::lock_guard<std::mutex> lock(mutexLatencies);
+            latencies.clear();
+        }
+        const double             cpuAtStart = GetProcessCpuSec();
+        const SClock::time_point start      = SClock::now();
+
+        std::this_thread::sleep_for(std::chrono::seconds(options.m_durationSec));
+
+        std::vector<double> windowLatencies;
+        {
+            std::lock_guard<std::mutex> lock(mutexLatencies);
+            windowLatencies.swap(latencies);
+        }
+        const double elapsedSec = std::chrono::duration_cast<std::chrono::microseconds>(SClock::now() - start).count() * 1e-6;
+        const double cpuSec     = GetProcessCpuSec() - cpuAtStart;
+        int64 framesAtEnd = 0;
+        for (size_t s = 0; s < streams.size(); ++s)
+            framesAtEnd += streams[s]->m_numFrames;
+
+        isRunning = false;
+        for (size_t c = 0; c < consumers.size(); ++c)
+            consumers[c].join();
+
+        const double fpsPerStream = (framesAtEnd - framesAtStart) / elapsedSec / n;
+        const double dropRate     = std::max(0.0, 1.0 - fpsPerStream / options.m_fps);
+        const double cpuPerStream = 100.0 * cpuSec / elapsedSec / n;
+        const double load         = cpuSec / elapsedSec / numCores;
+        const SProcessStats stats = SProcessStats::Get();
+
+        std::cout << "load: " << n << " " << fpsPerStream << " " << dropRate
+                  << " " << Percentile(windowLatencies, 0.50) << " " << Percentile(windowLatencies, 0.95) << " " << Percentile(windowLatencies, 0.99)
+                  << " " << cpuPerStream << " " << stats.m_residentSetSizeInBytes / (1024.0 * 1024.0) << std::endl;
+
+        if (options.m_jitterMs > 0 && !CheckLatency(options, relay.GetInjectedJitterMs(), streams))
+            hasLatencyFailure = true;
+
+        if (dropRate > options.m_maxDropRate)
+            saturationReason = "drop rate " + std::to_string(dropRate) + " above " + std::to_string(options.m_maxDropRate);
+        else if (load > 0.95)
+            saturationReason = "CPU load " + std::to_string(load) + " of " + std::to_string(numCores) + " cores";
+        if (!saturationReason.empty())
+        {
+            isSaturated = true;
+            saturatedAt = n;
+        }
+        else
+        {
+            saturation = n;
+        }
+    }
+
+    if (isSaturated)
+        std::cout << "load: saturation point: " << saturation << " streams (" << options.m_width << "x" << options.m_height << "@" << options.m_fps
+                  << "), at " << saturatedAt << " streams: " << saturationReason << std::endl;
+    else
+        std::cout << "load: not saturated at " << saturation << " streams" << std::endl;
+
+    const size_t numOpened = streams.size();
+    streams.clear();
+    relay.Stop();
+    server.Stop();
+    // not a single stream could be opened: nothing was measured
+    if (numOpened == 0)
+    {
+        std::cout << "load: FAILED, cannot open " << uri << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (hasLatencyFailure)
+    {
+        std::cout << "load: FAILED, the adaptive network caching did not absorb the injected jitter" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
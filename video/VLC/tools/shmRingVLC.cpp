@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2014 Digital Barriers plc. All rights reserved.
+ * Contact: http://www.digitalbarriers.com/
+ *
+ * This file is part of the Papillon SDK.
+ *
+ * You can't use, modify or distribute any part of this file without
+ * the explicit written agreements of Digital Barriers plc.
+ */
+
+// ****************************************************************************
+// Description:  two-process test of the shared-memory frame ring
+//               (SharedFrameRing.h, option "shm=NAME" of the plugin).
+//               A forked writer publishes frames as fast as it can while the
+//               parent reads them with the seqlock protocol.
+//
+//               --mode check (default): every byte of frame N is N % 256, so
+//               a frame accepted by EndRead() but mixing two frames (torn) is
+//               detected; fails if any torn frame is accepted, if no frame is
+//               accepted, or if re-creating the ring with a larger capacity
+//               does not bump the generation of the old one.
+//               --mode throughput: reports frames/s and GB/s on both sides,
+//               and the fraction of the frames the reader had to drop.
+//
+// Usage:        shmRingVLC [options]
+//               --mode check|throughput
+//               --width W --height H  frame geometry, RV24 (default 1920x1080)
+//               --slots S             slots of the ring (default 4)
+//               --seconds S           duration of each read phase (default 2)
+//
+// Linux only (POSIX shared memory, fork). Does not need libvlc nor Papillon.
+// ****************************************************************************
+
+#include "../SharedFrameRing.h"
+// STL
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/wait.h>
+
+typedef std::chrono::steady_clock SClock;
+
+const int SHM_RING_OPEN_TIMEOUT_IN_MS = 5000;
+
+
+struct SReadStats
+{
+    SReadStats()
+        : m_numAccepted(0)
+        , m_numDropped (0)
+        , m_numTorn    (0)
+        , m_numBytes   (0)
+    {
+    }
+
+    uint64_t m_numAccepted;   //!< frames read and validated by EndRead()
+    uint64_t m_numDropped;    //!< frames overwritten before or while they were read
+    uint64_t m_numTorn;       //!< frames validated by EndRead() whose content is not the one of a single frame
+    uint64_t m_numBytes;
+};
+
+
+// Returns the command sent by the parent on fd, or 0 if none is pending
+static char PollCommand(int fd)
+{
+    pollfd pfd = { fd, POLLIN, 0 };
+    char command = 0;
+    if (poll(&pfd, 1, 0) == 1 && read(fd, &command, 1) != 1)
+        command = 'q';
+    return command;
+}
+
+
+static void FillFrame(std::vector<unsigned char>& frame, uint64_t frameNumber)
+{
+    memset(&frame[0], int(frameNumber & 0xff), frame.size());
+}
+
+
+// Writer process: publishes frames into ring "name" until told to re-create it ('r', twice the capacity) or to quit ('q')
+static int RunWriter(const std::string& name, uint32_t numSlots, uint32_t frameSize, int commandFd)
+{
+    SSharedFrameRing ring;
+    std::vector<unsigned char> frame(frameSize);
+    uint64_t frameNumber = 0;
+
+    if (!ring.Create(name, numSlots, frameSize))
+        return EXIT_FAILURE;
+    for (;;)
+    {
+        // polling for commands every frame is cheap next to the copy of a frame
+        const char command = PollCommand(commandFd);
+        if (command == 'q')
+            break;
+        if (command == 'r')
+        {
+            frame.resize(frame.size() * 2);
+            if (!ring.Create(name, numSlots, uint32_t(frame.size())))
+                return EXIT_FAILURE;
+        }
+        FillFrame(frame, frameNumber);
+        ring.Publish(frameNumber, 0, 0, 0, 0, "RV24", &frame[0], uint32_t(frame.size()));
+        frameNumber++;
+    }
+    ring.Close();
+    return EXIT_SUCCESS;
+}
+
+
+static bool OpenRing(SSharedFrameRing& ring, const std::string& name, uint32_t minCapacity)
+{
+    const SClock::time_point deadline = SClock::now() + std::chrono::milliseconds(SHM_RING_OPEN_TIMEOUT_IN_MS);
+    while (SClock::now() < deadline)
+    {
+        // Open() fails until the writer has created the ring and set its magic
+        if (ring.Open(name) && ring.GetHeader()->m_dataCapacity >= minCapacity)
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+
+// Reads the frames in publication order for the given duration; copies each one out of the ring and checks it when asked to
+static SReadStats ReadFrames(const SSharedFrameRing& ring, double seconds, bool isChecked)
+{
+    SReadStats stats;
+    const SSharedFrameRingHeader* header = ring.GetHeader();
+    std::vector<unsigned char> copy(header->m_dataCapacity);
+    uint64_t next = header->m_numPublished.load(std::memory_order_acquire);
+
+    const SClock::time_point end = SClock::now() + std::chrono::microseconds(int64_t(seconds * 1e6));
+    while (SClock::now() < end)
+    {
+        const uint64_t numPublished = header->m_numPublished.load(std::memory_order_acquire);
+        if (next >= numPublished)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        // frames older than the ring are gone already
+        if (numPublished - next > header->m_numSlots)
+        {
+            stats.m_numDropped += numPublished - header->m_numSlots - next;
+            next = numPublished - header->m_numSlots;
+        }
+
+        SSharedFrameSlotHeader* slot = NULL;
+        const uint64_t sequence = ring.BeginRead(next, slot);
+        uint64_t frameNumber = 0;
+        uint32_t dataSize    = 0;
+        if (sequence != 0)
+        {
+            frameNumber = slot->m_frameNumber;
+            dataSize    = std::min(slot->m_dataSize, header->m_dataCapacity);
+            memcpy(&copy[0], SSharedFrameRing::GetSlotData(slot), dataSize);
+        }
+        if (sequence == 0 || !ring.EndRead(slot, sequence))
+        {
+            stats.m_numDropped++;
+            next++;
+            continue;
+        }
+
+        stats.m_numAccepted++;
+        stats.m_numBytes += dataSize;
+        if (isChecked)
+        {
+            const unsigned char expected = static_cast<unsigned char>(frameNumber & 0xff);
+            for (uint32_t i = 0; i < dataSize; ++i)
+            {
+                if (copy[i] != expected)
+                {
+                    stats.m_numTorn++;
+                    break;
+                }
+            }
+        }
+        next++;
+    }
+    return stats;
+}
+
+
+static void PrintReadStats(const char* label, const SReadStats& stats, uint64_t numPublished, double seconds)
+{
+    std::cout << label
+              << " published=" << numPublished
+              << " accepted=" << stats.m_numAccepted
+              << " dropped=" << stats.m_numDropped
+              << " torn=" << stats.m_numTorn
+              << " readerFps=" << stats.m_numAccepted / seconds
+              << " readerGBps=" << stats.m_numBytes / seconds / 1e9 << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::string mode     = "check";
+    int         width    = 1920;
+    int         height   = 1080;
+    int         numSlots = 4;
+    double      seconds  = 2.0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if      (arg == "--mode"    && hasValue) mode     = argv[++i];
+        else if (arg == "--width"   && hasValue) width    = atoi(argv[++i]);
+        else if (arg == "--height"  && hasValue) height   = atoi(argv[++i]);
+        else if (arg == "--slots"   && hasValue) numSlots = atoi(argv[++i]);
+        else if (arg == "--seconds" && hasValue) seconds  = atof(argv[++i]);
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--mode check|throughput] [--width W] [--height H] [--slots S] [--seconds S]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if ((mode != "check" && mode != "throughput") || width <= 0 || height <= 0 || numSlots <= 0 || seconds <= 0.0)
+    {
+        std::cerr << "shm: bad arguments" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::string name      = "/papillon-vlc-shm-ring-test-" + std::to_string(getpid());
+    const uint32_t    frameSize = uint32_t(width) * uint32_t(height) * 3;
+
+    int commandPipe[2];
+    if (pipe(commandPipe) != 0)
+    {
+        std::cerr << "shm: pipe() failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const pid_t writer = fork();
+    if (writer < 0)
+    {
+        std::cerr << "shm: fork() failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (writer == 0)
+    {
+        close(commandPipe[1]);
+        _exit(RunWriter(name, uint32_t(numSlots), frameSize, commandPipe[0]));
+    }
+    close(commandPipe[0]);
+
+    bool isOk = true;
+    SSharedFrameRing ring;
+    if (!OpenRing(ring, name, frameSize))
+    {
+        std::cout << "shm: FAILED, cannot open ring " << name << std::endl;
+        isOk = false;
+    }
+    else
+    {
+        const SReadStats stats = ReadFrames(ring, seconds, mode == "check");
+        const uint64_t numPublished = ring.GetHeader()->m_numPublished.load(std::memory_order_acquire);
+        PrintReadStats("shm:", stats, numPublished, seconds);
+
+        if (mode == "throughput")
+        {
+            std::cout << "shm: throughput " << width << "x" << height << " slots=" << numSlots
+                      << " writerFps=" << numPublished / seconds
+                      << " writerGBps=" << double(numPublished) * frameSize / seconds / 1e9
+                      << " dropRate=" << (stats.m_numAccepted + stats.m_numDropped == 0 ? 0.0 : double(stats.m_numDropped) / double(stats.m_numAccepted + stats.m_numDropped)) << std::endl;
+        }
+        else
+        {
+            if (stats.m_numTorn != 0 || stats.m_numAccepted == 0)
+            {
+                std::cout << "shm: FAILED, " << stats.m_numTorn << " torn frames accepted, " << stats.m_numAccepted << " frames accepted" << std::endl;
+                isOk = false;
+            }
+
+            // the writer re-creates the ring with a larger capacity: the old one must be abandoned (generation bumped)
+            const uint32_t generation = ring.GetHeader()->m_generation.load(std::memory_order_acquire);
+            if (write(commandPipe[1], "r", 1) != 1)
+                isOk = false;
+            const SClock::time_point deadline = SClock::now() + std::chrono::milliseconds(SHM_RING_OPEN_TIMEOUT_IN_MS);
+            while (ring.GetHeader()->m_generation.load(std::memory_order_acquire) == generation && SClock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (ring.GetHeader()->m_generation.load(std::memory_order_acquire) == generation)
+            {
+                std::cout << "shm: FAILED, generation not bumped when the ring is re-created" << std::endl;
+                isOk = false;
+            }
+            else if (!OpenRing(ring, name, frameSize * 2))
+            {
+                std::cout << "shm: FAILED, cannot re-open the re-created ring" << std::endl;
+                isOk = false;
+            }
+            else
+            {
+                const SReadStats statsAfter = ReadFrames(ring, seconds, true);
+                PrintReadStats("shm: re-created", statsAfter, ring.GetHeader()->m_numPublished.load(std::memory_order_acquire), seconds);
+                if (statsAfter.m_numTorn != 0 || statsAfter.m_numAccepted == 0)
+                {
+                    std::cout << "shm: FAILED, " << statsAfter.m_numTorn << " torn frames accepted after re-creation" << std::endl;
+                    isOk = false;
+                }
+            }
+        }
+    }
+
+    if (write(commandPipe[1], "q", 1) != 1)
+        isOk = false;
+    close(commandPipe[1]);
+    int status = 0;
+    waitpid(writer, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+    {
+        std::cout << "shm: FAILED, writer exited abnormally" << std::endl;
+        isOk = false;
+    }
+    ring.Close();
+
+    std::cout << (isOk ? "shm: OK" : "shm: FAILED") << std::endl;
+    return isOk ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2014 Digital Barriers plc. All rights reserved.
+ * Contact: http://www.digitalbarriers.com/
+ *
+ * This file is part of the Papillon SDK.
+ *
+ * You can't use, modify or distribute any part of this file without
+ * the explicit written agreements of Digital Barriers plc.
+ */
+
+// ****************************************************************************
+// Description:  soak test of the VLC input video stream plugin: opens, reads a
+//               few frames from and closes thousands of streams from several
+//               threads, while tracking the resident memory, the number of
+//               open file descriptors and the number of threads of the
+//               process. Fails if they keep growing after the warm-up.
+//               Both the baseline and the end sample are taken with no stream
+//               open: the workers are paused after the warm-up until the
+//               streams they had open are closed.
+//               Also fails if no stream could be opened at all, or if more
+//               opens or frames than --max-failure-rate failed: resources that
+//               do not grow because nothing was decoded prove nothing.
+//
+// Usage:        soakVLC [options] [URI...]
+//               --threads N          number of threads opening streams (default 4)
+//               --cycles N           total number of open/close cycles (default 2000)
+//               --frames N           frames read per open (default 5)
+//               --warmup N           cycles before the baseline is taken (default 100)
+//               --max-rss-growth MB  allowed RSS growth after warm-up (default 32)
+//               --max-fd-growth N    allowed growth of open file descriptors (default 4)
+//               --max-thread-growth N allowed growth of threads (default 4)
+//               --max-failure-rate R allowed fraction of failed opens and of failed frames (default 0.01)
+//               --server rtsp|http   (Linux only) also soak a stand-in camera: a clip generated
+//                                    with ffmpeg served in loop by a local VLC process (see
+//                                    StandInServer.h, shared with loadTestVLC)
+//               --vlc PATH           VLC executable of the stand-in camera (default cvlc)
+//               --port P             port of the stand-in camera (default 8554)
+// ****************************************************************************
+
+#include <PapillonCore.h>
+#include "../ProcessStats.h"
+#ifdef __linux__
+#include "StandInServer.h"
+#endif
+// STL
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace papillon;
+
+const int32 SOAK_CLIP_WIDTH  = 640;
+const int32 SOAK_CLIP_HEIGHT = 360;
+const int32 SOAK_CLIP_FPS    = 25;
+
+
+static void PrintStats(const char* label, int32 cycles, const SProcessStats& stats)
+{
+    std::cout << label << " cycles=" << cycles
+              << " rssMB=" << stats.m_residentSetSizeInBytes / (1024.0 * 1024.0)
+              << " fds=" << stats.m_numFileDescriptors
+              << " threads=" << stats.m_numThreads << std::endl;
+}
+
+
+int main(int argc, char** argv)
+{
+    int32 numThreads      = 4;
+    int32 numCycles       = 2000;
+    int32 numFrames       = 5;
+    int32 numWarmUpCycles = 100;
+    double maxRssGrowthMB = 32.0;
+    int32 maxFdGrowth     = 4;
+    int32 maxThreadGrowth = 4;
+    double maxFailureRate = 0.01;
+    std::string server;
+    std::string vlc       = "cvlc";
+    int32 port            = 8554;
+    std::vector<std::string> uris;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if      (arg == "--threads"           && hasValue) numThreads      = atoi(argv[++i]);
+        else if (arg == "--cycles"            && hasValue) numCycles       = atoi(argv[++i]);
+        else if (arg == "--frames"            && hasValue) numFrames       = atoi(argv[++i]);
+        else if (arg == "--warmup"            && hasValue) numWarmUpCycles = atoi(argv[++i]);
+        else if (arg == "--max-rss-growth"    && hasValue) maxRssGrowthMB  = atof(argv[++i]);
+        else if (arg == "--max-fd-growth"     && hasValue) maxFdGrowth     = atoi(argv[++i]);
+        else if (arg == "--max-thread-growth" && hasValue) maxThreadGrowth = atoi(argv[++i]);
+        else if (arg == "--max-failure-rate"  && hasValue) maxFailureRate  = atof(argv[++i]);
+        else if (arg == "--server"            && hasValue) server          = argv[++i];
+        else if (arg == "--vlc"               && hasValue) vlc             = argv[++i];
+        else if (arg == "--port"              && hasValue) port            = atoi(argv[++i]);
+        else uris.push_back(arg);
+    }
+
+    if ((uris.empty() && server.empty()) || (!server.empty() && server != "rtsp" && server != "http"))
+    {
+        std::cerr << "usage: " << argv[0] << " [--threads N] [--cycles N] [--frames N] [--warmup N] [--max-rss-growth MB] [--max-fd-growth N] [--max-thread-growth N]"
+                  << " [--max-failure-rate R] [--server rtsp|http] [--vlc PATH] [--port P] [URI...]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    PapillonSDK::Initialise().OrDie();
+
+    // stand-in camera, soaked together with the given URIs
+#ifdef __linux__
+    SStandInServer standIn;
+    if (!server.empty())
+    {
+        const std::string clip = SStandInServer::GenerateClip("soakVLC", SOAK_CLIP_WIDTH, SOAK_CLIP_HEIGHT, SOAK_CLIP_FPS);
+        if (clip.empty())
+        {
+            std::cerr << "soak: failed to generate the clip (is ffmpeg installed?)" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!standIn.Start(vlc, server, port, clip))
+        {
+            std::cerr << "soak: failed to start " << vlc << std::endl;
+            return EXIT_FAILURE;
+        }
+        uris.push_back(standIn.GetUri());
+        std::cout << "soak: stand-in camera at " << standIn.GetUri() << std::endl;
+    }
+#else
+    if (!server.empty())
+    {
+        std::cerr << "soak: --server is only supported on Linux" << std::endl;
+        return EXIT_FAILURE;
+    }
+#endif
+
+    std::atomic<int32> nextCycle(0);
+    std::atomic<int32> numDone(0);
+    std::atomic<int32> numFailedOpens(0);
+    std::atomic<int32> numFrameReads(0);
+    std::atomic<int32> numFailedFrames(0);
+    std::atomic<bool>  isPaused(false);
+    std::atomic<int32> numActive(0);          // workers between opening and closing a stream
+
+    std::vector<std::thread> threads;
+    for (int32 t = 0; t < numThreads; ++t)
+    {
+        threads.push_back(std::thread([&]
+        {
+            for (;;)
+            {
+                while (isPaused)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                numActive++;
+                if (isPaused)
+                {
+                    // paused in between: the main thread may already have seen numActive == 0
+                    numActive--;
+                    continue;
+                }
+                const int32 cycle = nextCycle++;
+                if (cycle >= numCycles)
+                {
+                    numActive--;
+                    break;
+                }
+
+                {
+                    PInputVideoStream ivs;
+                    if (PInputVideoStream::Open(uris[cycle % uris.size()].c_str(), ivs).Failed())
+                    {
+                        numFailedOpens++;
+                    }
+                    else
+                    {
+                        PFrame frame;
+                        for (int32 f = 0; f < numFrames; ++f)
+                        {
+                            numFrameReads++;
+                            if (ivs.GetFrame(frame, 2000).Failed())
+                                numFailedFrames++;
+                        }
+                    }
+                    // the stream is closed here
+                }
+                numDone++;
+                numActive--;
+            }
+        }));
+    }
+
+    // take the baseline once the warm-up cycles are done (libvlc modules loaded, caches filled...), with no stream open like the
+    // end sample, so that the memory, descriptors and threads of the open streams are not counted as growth
+    SProcessStats baseline;
+    bool hasBaseline = false;
+    while (numDone < numCycles)
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        PrintStats("soak:", numDone, SProcessStats::Get());
+        if (!hasBaseline && numDone >= numWarmUpCycles)
+        {
+            isPaused = true;
+            while (numActive > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // let the libvlc threads of the last streams exit, as before the end sample
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+            baseline    = SProcessStats::Get();
+            hasBaseline = true;
+            PrintStats("soak: baseline", numDone, baseline);
+            isPaused = false;
+        }
+    }
+
+    for (size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+
+    // let the libvlc threads of the last streams exit
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    const SProcessStats end = SProcessStats::Get();
+    if (!hasBaseline)
+        baseline = end;
+    PrintStats("soak: end", numDone, end);
+
+    const double rssGrowthMB  = (end.m_residentSetSizeInBytes - baseline.m_residentSetSizeInBytes) / (1024.0 * 1024.0);
+    const int32  fdGrowth     = end.m_numFileDescriptors - baseline.m_numFileDescriptors;
+    const int32  threadGrowth = end.m_numThreads - baseline.m_numThreads;
+
+    const double openFailureRate  = numCycles > 0 ? double(numFailedOpens) / numCycles : 0.0;
+    const double frameFailureRate = numFrameReads > 0 ? double(numFailedFrames) / numFrameReads : 0.0;
+
+    std::cout << "soak: " << numCycles << " cycles, " << numFailedOpens << " failed opens, " << numFailedFrames << " failed frames out of "
+              << numFrameReads << std::endl;
+    std::cout << "soak: growth after warm-up: rss " << rssGrowthMB << " MB, fds " << fdGrowth << ", threads " << threadGrowth << std::endl;
+
+    if (numCycles > 0 && numFailedOpens == numCycles)
+    {
+        std::cout << "soak: FAILED, no stream could be opened" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (openFailureRate > maxFailureRate || frameFailureRate > maxFailureRate)
+    {
+        std::cout << "soak: FAILED, " << 100.0 * openFailureRate << "% of the opens and " << 100.0 * frameFailureRate
+                  << "% of the frames failed (at most " << 100.0 * maxFailureRate << "% allowed)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (rssGrowthMB > maxRssGrowthMB || fdGrowth > maxFdGrowth || threadGrowth > maxThreadGrowth)
+    {
+        std::cout << "soak: FAILED, resources keep growing" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "soak: OK" << std::endl;
+    return EXIT_SUCCESS;
+}